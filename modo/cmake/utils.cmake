@@ -29,6 +29,7 @@ function(add_modo_plugin name)
     target_link_libraries(${name}
         PUBLIC
             lxsdk
+            Threads::Threads
     )
 
     # Make this a custom build target so it isn't only fired during configure
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Flat open addressing table from the SDK's point ids to a uint32, used by the falloffs to
+// find a point's part or index without going through a shared accessor.  The ids are
+// pointers as far as the SDK is concerned, so they're just treated as opaque keys, with
+// zero meaning no point.  Built once, then only read, so lookups are safe from any number
+// of threads.
+// None of this touches the SDK, so it's safe to use from SDK-free code.
+namespace util
+{
+    class IdTable
+    {
+    public:
+        // What find gives for ids the table doesn't have, the same as the cores' invalidIndex.
+        static constexpr uint32_t missing = std::numeric_limits<uint32_t>::max();
+
+        // Maps ids[i] to values[i].
+        void build(const std::vector<uintptr_t>& ids, const std::vector<uint32_t>& values)
+        {
+            build(ids, [&values](uint32_t i) { return values[i]; });
+        }
+
+        // Maps ids[i] to i.
+        void build(const std::vector<uintptr_t>& ids)
+        {
+            build(ids, [](uint32_t i) { return i; });
+        }
+
+        void clear()
+        {
+            m_slots.clear();
+            m_mask  = 0u;
+            m_shift = 0u;
+        }
+
+        bool empty() const
+        {
+            return m_slots.empty();
+        }
+
+        uint32_t find(uintptr_t id) const
+        {
+            if (m_slots.empty() || id == 0u)
+                return missing;
+
+            for (auto slot = hash(id);; slot = (slot + 1u) & m_mask)
+            {
+                const auto& entry = m_slots[slot];
+                if (entry.id == id)
+                    return entry.value;
+                if (entry.id == 0u)
+                    return missing;
+            }
+        }
+
+        // Looks up a run of ids at once, for the batched falloff paths.
+        template <typename Id>
+        void findRun(const Id* ids, uint32_t count, uint32_t* values) const
+        {
+            for (auto i = 0u; i < count; ++i)
+                values[i] = find(reinterpret_cast<uintptr_t>(ids[i]));
+        }
+
+    private:
+        struct Slot
+        {
+            uintptr_t id{};
+            uint32_t  value{ missing };
+        };
+
+        template <typename ValueOf>
+        void build(const std::vector<uintptr_t>& ids, ValueOf valueOf)
+        {
+            clear();
+            if (ids.empty())
+                return;
+
+            // At most half full, so probe runs stay short.
+            auto bits = 1u;
+            while ((1ull << bits) < ids.size() * 2u)
+                ++bits;
+
+            m_slots.assign(1ull << bits, Slot{});
+            m_mask  = m_slots.size() - 1u;
+            m_shift = 64u - bits;
+
+            for (auto i = 0u; i < ids.size(); ++i)
+            {
+                if (ids[i] == 0u)
+                    continue;
+
+                auto slot = hash(ids[i]);
+                while (m_slots[slot].id != 0u && m_slots[slot].id != ids[i])
+                    slot = (slot + 1u) & m_mask;
+
+                m_slots[slot].id    = ids[i];
+                m_slots[slot].value = valueOf(i);
+            }
+        }
+
+        // Fibonacci hashing, the ids are allocator addresses so their low bits are poor.
+        uint64_t hash(uintptr_t id) const
+        {
+            return (static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> m_shift;
+        }
+
+        std::vector<Slot> m_slots;
+        uint64_t          m_mask{};
+        uint32_t          m_shift{};
+    };
+}  // namespace util
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small helpers for splitting flat loops over every core.  The range is cut into
+// fixed size chunks that workers claim from a shared counter, so a worker that
+// finishes early keeps taking chunks instead of idling while the others catch up.
+// The workers are kept parked in a pool between loops, so the interactive paths that
+// run a loop per mouse move don't pay for starting threads every time.
+// None of this touches the SDK, so it's safe to use from SDK-free code.
+namespace parallel
+{
+    inline uint32_t workerCount()
+    {
+        const auto hw = std::thread::hardware_concurrency();
+        return hw ? hw : 1u;
+    }
+
+    namespace detail
+    {
+        // Set while a thread is running chunks.  Loops nested inside one run inline on
+        // that thread, rather than each starting another full set of threads.
+        inline bool& insideChunk()
+        {
+            thread_local bool inside = false;
+            return inside;
+        }
+
+        // workerCount() - 1 threads, started on first use, that sleep until a loop hands
+        // them a job.  One loop has the pool at a time, a loop started on another thread
+        // while it's busy just runs on its own thread instead of waiting.
+        class Pool
+        {
+        public:
+            using Job = void (*)(void* context, uint32_t worker);
+
+            static Pool& instance()
+            {
+                // Never destroyed.  The threads are left parked when the process exits,
+                // joining them while a plugin unloads can deadlock on Windows.
+                static Pool* pool = new Pool();
+                return *pool;
+            }
+
+            // Runs job on the calling thread as worker 0 and on helpers more pool threads,
+            // as workers 1 to helpers, and returns once they've all finished.  Returns false
+            // without running anything if another loop has the pool.
+            bool tryRun(uint32_t helpers, Job job, void* context)
+            {
+                std::unique_lock<std::mutex> owner(m_owner, std::try_to_lock);
+                if (!owner.owns_lock())
+                    return false;
+
+                helpers = std::min(helpers, static_cast<uint32_t>(m_threads.size()));
+                {
+                    std::lock_guard<std::mutex> lock(m_lock);
+                    m_job     = job;
+                    m_context = context;
+                    m_wanted  = helpers;
+                    m_claimed = 0u;
+                    m_running = helpers;
+                    ++m_generation;
+                }
+                m_wake.notify_all();
+
+                job(context, 0u);
+
+                std::unique_lock<std::mutex> lock(m_lock);
+                m_done.wait(lock, [this] { return m_running == 0u; });
+                return true;
+            }
+
+        private:
+            Pool()
+            {
+                const auto hw    = std::thread::hardware_concurrency();
+                const auto count = hw > 1u ? hw - 1u : 0u;
+                m_threads.reserve(count);
+                for (auto i = 0u; i < count; ++i)
+                {
+                    m_threads.emplace_back([this] { work(); });
+                    m_threads.back().detach();
+                }
+            }
+
+            void work()
+            {
+                uint64_t                     seen = 0u;
+                std::unique_lock<std::mutex> lock(m_lock);
+                for (;;)
+                {
+                    m_wake.wait(lock, [&] { return m_generation != seen; });
+                    seen = m_generation;
+
+                    // Every thread wakes for a job, but only the first few it asked for
+                    // take part.
+                    if (m_claimed >= m_wanted)
+                        continue;
+
+                    const auto worker  = ++m_claimed;
+                    const auto job     = m_job;
+                    auto*      context = m_context;
+                    lock.unlock();
+                    job(context, worker);
+                    lock.lock();
+
+                    if (--m_running == 0u)
+                        m_done.notify_all();
+                }
+            }
+
+            std::vector<std::thread> m_threads;
+            std::mutex               m_owner;  // Held by the loop using the pool
+            std::mutex               m_lock;
+            std::condition_variable  m_wake;
+            std::condition_variable  m_done;
+            Job                      m_job{};
+            void*                    m_context{};
+            uint32_t                 m_wanted{};
+            uint32_t                 m_claimed{};
+            uint32_t                 m_running{};
+            uint64_t                 m_generation{};
+        };
+    }  // namespace detail
+
+    inline uint32_t chunkCount(uint32_t count, uint32_t grain)
+    {
+        grain = std::max(grain, 1u);
+        return static_cast<uint32_t>((static_cast<uint64_t>(count) + grain - 1u) / grain);
+    }
+
+    // Calls fn(chunk, begin, end, worker) for every chunk of the range.  Chunk indices
+    // are stable for a given count and grain, so callers that need a deterministic
+    // result can write into per-chunk storage and merge in chunk order afterwards.
+    // Worker indices are below workerCount() and are handy for per-thread scratch.
+    template <typename Fn>
+    void forChunks(uint32_t count, uint32_t grain, Fn&& fn)
+    {
+        if (count == 0u)
+            return;
+
+        grain                 = std::max(grain, 1u);
+        const uint32_t chunks = chunkCount(count, grain);
+
+        // Only a loop that actually went wide stops the ones inside it from doing the same.
+        const uint32_t workers = detail::insideChunk() ? 1u : std::min(workerCount(), chunks);
+
+        std::atomic<uint32_t> next{ 0u };
+        bool                  wide = false;
+        auto                  run  = [&](uint32_t worker)
+        {
+            auto&      inside = detail::insideChunk();
+            const bool outer  = inside;
+            inside            = outer || wide;
+            for (auto chunk = next.fetch_add(1u); chunk < chunks; chunk = next.fetch_add(1u))
+            {
+                const auto begin = static_cast<uint32_t>(static_cast<uint64_t>(chunk) * grain);
+                const auto end   = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(begin) + grain, count));
+                fn(chunk, begin, end, worker);
+            }
+            inside = outer;
+        };
+
+        // The pool only takes a plain function and pointer, so nothing is allocated to hand
+        // the loop over.  If another thread's loop has the pool, this one just runs here.
+        auto job = [](void* context, uint32_t worker) { (*static_cast<decltype(run)*>(context))(worker); };
+        wide     = workers > 1u;
+        if (!wide || !detail::Pool::instance().tryRun(workers - 1u, job, &run))
+        {
+            wide = false;
+            run(0u);
+        }
+    }
+
+    // Calls fn(i) for every index, for loops where each item is independent.
+    template <typename Fn>
+    void forEach(uint32_t count, uint32_t grain, Fn&& fn)
+    {
+        forChunks(count,
+                  grain,
+                  [&](uint32_t, uint32_t begin, uint32_t end, uint32_t)
+                  {
+                      for (auto i = begin; i < end; ++i)
+                          fn(i);
+                  });
+    }
+}  // namespace parallel
@@ -0,0 +1,59 @@
+#pragma once
+
+// Shared setup for the files with SIMD kernels in them: which intrinsics can be compiled,
+// how to mark a function as using them, and what the cpu running us supports.  Only
+// include it from .cxx files, so the intrinsics never leak into the plugins' headers.
+// None of this touches the SDK, so it's safe to use from SDK-free code.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows the intrinsics anywhere, so no per-function target is needed.
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#ifdef SIMD_X86
+namespace simd
+{
+    struct CpuFeatures
+    {
+        bool sse4{};
+        bool avx2{};
+
+        CpuFeatures()
+        {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            const int maxLeaf = info[0];
+
+            __cpuid(info, 1);
+            sse4               = (info[2] & (1 << 19)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx     = (info[2] & (1 << 28)) != 0;
+            // AVX2 also needs the OS to save the ymm registers.
+            if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+            {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+#else
+            __builtin_cpu_init();
+            sse4 = __builtin_cpu_supports("sse4.1");
+            avx2 = __builtin_cpu_supports("avx2");
+#endif
+        }
+    };
+
+    // Probed once, on first use.
+    inline const CpuFeatures& cpuFeatures()
+    {
+        static const CpuFeatures features;
+        return features;
+    }
+}  // namespace simd
+#endif
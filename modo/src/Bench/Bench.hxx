@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Small timing helpers shared by the benchmark suites.
+namespace bench
+{
+    struct Settings
+    {
+        double minSeconds{ 0.25 };  // Each measurement repeats until it's run this long
+    };
+
+    // Runs fn, which does work units of work per call, until at least minSeconds have gone
+    // by, and returns the units per second.
+    template <typename Fn>
+    double throughput(const Settings& settings, uint64_t work, Fn&& fn)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // One untimed call first, so page faults and lazily started threads don't count.
+        fn();
+
+        uint64_t   calls = 0u;
+        const auto start = clock::now();
+        auto       now   = start;
+        do
+        {
+            fn();
+            ++calls;
+            now = clock::now();
+        } while (std::chrono::duration<double>(now - start).count() < settings.minSeconds);
+
+        return static_cast<double>(work * calls) / std::chrono::duration<double>(now - start).count();
+    }
+
+    // Keeps the compiler from dropping work whose result isn't otherwise used.
+    void keep(uint64_t value);
+
+    // The suites, each prints its own table.
+    void thicknessKernels(const Settings& settings);
+    void thicknessSampling(const Settings& settings);
+    void falloffReaders(const Settings& settings);
+}  // namespace bench
@@ -0,0 +1,158 @@
+#include "Bench.hxx"
+
+#include <ModelingFalloff/Kernels.hxx>
+#include <util/IdTable.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace bench
+{
+    namespace
+    {
+        static constexpr uint32_t pointCount = 1u << 18u;
+        static constexpr uint32_t partCount  = 4096u;
+        static constexpr uint32_t runSize    = 256u;  // Points per fall_WeightRun call
+
+        // The falloff before the weight table: every point went through one locked point
+        // accessor to find its part, then the weight cache behind a second lock.  The
+        // accessor is stood in for by a hash map, which is cheaper than the real thing, so
+        // this flatters the old path if anything.
+        class LockedFalloff
+        {
+        public:
+            LockedFalloff(const std::vector<uintptr_t>& ids, const std::vector<uint32_t>& parts, const std::vector<float>& weights)
+            {
+                for (auto i = 0u; i < ids.size(); ++i)
+                    m_pointParts[ids[i]] = parts[i];
+                for (auto part = 0u; part < weights.size(); ++part)
+                    m_cache[part] = weights[part];
+            }
+
+            float weight(uintptr_t id)
+            {
+                uint32_t part{};
+                {
+                    std::lock_guard<std::mutex> scopeLock(m_accessorLock);
+                    part = m_pointParts.find(id)->second;
+                }
+
+                std::optional<double> cached;
+                {
+                    std::lock_guard<std::mutex> scopeLock(m_cacheLock);
+                    auto                        it = m_cache.find(part);
+                    if (it != m_cache.end())
+                        cached = it->second;
+                }
+                return cached ? static_cast<float>(*cached) : 1.0f;
+            }
+
+        private:
+            std::unordered_map<uintptr_t, uint32_t> m_pointParts;
+            std::unordered_map<uint32_t, double>    m_cache;
+            std::mutex                              m_accessorLock;
+            std::mutex                              m_cacheLock;
+        };
+
+        // Runs fn(begin, end, weights) over the points in runs from every thread at once,
+        // each thread starting at its own offset, and returns the points per second over all
+        // of them.
+        template <typename Fn>
+        double readers(const Settings& settings, uint32_t threadCount, Fn&& fn)
+        {
+            std::atomic<uint32_t> ready{ 0u };
+            std::atomic<bool>     stop{ false };
+            std::vector<uint64_t> done(threadCount, 0u);
+
+            std::vector<std::thread> threads;
+            for (auto t = 0u; t < threadCount; ++t)
+                threads.emplace_back(
+                    [&, t]()
+                    {
+                        float    weights[runSize];
+                        uint64_t count = 0u;
+                        auto     first = (t * 7919u * runSize) % pointCount;
+
+                        ready.fetch_add(1u);
+                        while (ready.load() < threadCount)
+                            std::this_thread::yield();
+
+                        while (!stop.load(std::memory_order_relaxed))
+                        {
+                            fn(first, first + runSize, weights);
+                            first = (first + runSize) % pointCount;
+                            count += runSize;
+                        }
+                        done[t] = count;
+                        keep(static_cast<uint64_t>(weights[0] * 1000.0f));
+                    });
+
+            while (ready.load() < threadCount)
+                std::this_thread::yield();
+
+            const auto start = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(std::chrono::duration<double>(settings.minSeconds));
+            stop = true;
+            for (auto& thread : threads)
+                thread.join();
+            const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            uint64_t total = 0u;
+            for (auto count : done)
+                total += count;
+            return static_cast<double>(total) / seconds;
+        }
+    }  // namespace
+
+    void falloffReaders(const Settings& settings)
+    {
+        // Point ids look like the SDK's, scattered heap addresses.
+        std::vector<uintptr_t> ids(pointCount);
+        std::vector<uint32_t>  parts(pointCount);
+        for (auto i = 0u; i < pointCount; ++i)
+        {
+            ids[i]   = 0x10000000u + static_cast<uintptr_t>(i) * 48u + (i * 2654435761u & 0x30u);
+            parts[i] = i / (pointCount / partCount);
+        }
+
+        std::vector<float> weights(partCount);
+        for (auto part = 0u; part < partCount; ++part)
+            weights[part] = static_cast<float>(part) / partCount;
+
+        LockedFalloff locked(ids, parts, weights);
+
+        util::IdTable lookup;
+        lookup.build(ids, parts);
+        const auto gather = partCore::gatherKernel(partCore::bestIsa());
+
+        std::printf("%u points in %u parts, runs of %u, %u hardware threads\n\n", pointCount, partCount, runSize, std::thread::hardware_concurrency());
+        std::printf("%-8s %18s %18s %10s\n", "readers", "locked Mpoints/s", "table Mpoints/s", "speedup");
+        for (auto threadCount : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+        {
+            const auto old = readers(settings,
+                                     threadCount,
+                                     [&](uint32_t begin, uint32_t end, float* out)
+                                     {
+                                         for (auto i = begin; i < end; ++i)
+                                             out[i - begin] = locked.weight(ids[i]);
+                                     });
+
+            const auto table = readers(settings,
+                                       threadCount,
+                                       [&](uint32_t begin, uint32_t end, float* out)
+                                       {
+                                           uint32_t found[runSize];
+                                           lookup.findRun(ids.data() + begin, end - begin, found);
+                                           gather(weights.data(), partCount, found, end - begin, 1.0f, out);
+                                       });
+
+            std::printf("%-8u %18.2f %18.2f %9.1fx\n", threadCount, old / 1e6, table / 1e6, table / old);
+        }
+    }
+}  // namespace bench
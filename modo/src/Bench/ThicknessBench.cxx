@@ -0,0 +1,253 @@
+#include "Bench.hxx"
+
+#include <ThicknessChecker/Engine.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace bench
+{
+    namespace
+    {
+        static constexpr thicknessCore::Isa isas[] = { thicknessCore::Isa::scalar, thicknessCore::Isa::sse4, thicknessCore::Isa::avx2 };
+
+        // A closed shell between two spheres, like a thick walled part, with one ray per
+        // quad fired from its middle across the wall.  The rays come out in grid order, so
+        // neighbouring rays start on neighbouring quads, as they would from a real mesh.
+        struct Shell
+        {
+            std::vector<thicknessCore::Triangle> tris;
+            std::vector<thicknessCore::Ray>      rays;
+        };
+
+        Shell makeShell(uint32_t segments)
+        {
+            const auto rings = segments / 2u;
+            const auto pi    = 3.14159265f;
+
+            auto point = [&](float radius, uint32_t u, uint32_t v)
+            {
+                const auto theta = 2.0f * pi * static_cast<float>(u) / static_cast<float>(segments);
+                const auto phi   = pi * static_cast<float>(v) / static_cast<float>(rings);
+                return thicknessCore::Vec3{ radius * std::sin(phi) * std::cos(theta), radius * std::sin(phi) * std::sin(theta), radius * std::cos(phi) };
+            };
+
+            Shell shell;
+            auto  poly = 0u;
+            for (auto radius : { 1.0f, 0.8f })
+                for (auto v = 0u; v < rings; ++v)
+                    for (auto u = 0u; u < segments; ++u, ++poly)
+                    {
+                        const auto a = point(radius, u, v);
+                        const auto b = point(radius, u + 1u, v);
+                        const auto c = point(radius, u + 1u, v + 1u);
+                        const auto d = point(radius, u, v + 1u);
+                        shell.tris.push_back({ a, b, c, poly });
+                        shell.tris.push_back({ a, c, d, poly });
+
+                        // Outer quads fire inwards, inner ones outwards.
+                        const auto         sign = radius == 1.0f ? -1.0f : 1.0f;
+                        thicknessCore::Ray ray;
+                        auto               length = 0.0f;
+                        for (auto i = 0u; i < 3u; ++i)
+                        {
+                            ray.origin[i] = (a[i] + b[i] + c[i] + d[i]) * 0.25f;
+                            length += ray.origin[i] * ray.origin[i];
+                        }
+                        length = std::sqrt(length);
+                        for (auto i = 0u; i < 3u; ++i)
+                            ray.dir[i] = sign * ray.origin[i] / length;
+                        ray.ignorePoly = poly;
+                        shell.rays.push_back(ray);
+                    }
+
+            return shell;
+        }
+
+        thicknessCore::MeshInput makeInput(const Shell& shell)
+        {
+            thicknessCore::MeshInput input;
+            input.rays = shell.rays;
+            input.tris = shell.tris;
+            input.polyIds.resize(shell.rays.size());
+            input.triOffsets.resize(shell.rays.size() + 1u);
+            for (auto i = 0u; i <= shell.rays.size(); ++i)
+            {
+                if (i < shell.rays.size())
+                    input.polyIds[i] = i;
+                input.triOffsets[i] = i * 2u;
+            }
+            return input;
+        }
+
+        // The leaf kernels on their own, one ray against every block of one leaf's worth of
+        // triangles at a time.
+        void blockKernels(const Settings& settings, const Shell& shell)
+        {
+            static constexpr uint32_t blockCount = 4u;
+
+            std::vector<thicknessCore::TriangleBlock> blocks(blockCount);
+            for (auto b = 0u; b < blockCount; ++b)
+                for (auto lane = 0u; lane < thicknessCore::blockWidth; ++lane)
+                {
+                    const auto& tri = shell.tris[(b * thicknessCore::blockWidth + lane) * 97u % shell.tris.size()];
+                    for (auto a = 0u; a < 3u; ++a)
+                    {
+                        blocks[b].v0[a][lane] = tri.v0[a];
+                        blocks[b].e1[a][lane] = tri.v1[a] - tri.v0[a];
+                        blocks[b].e2[a][lane] = tri.v2[a] - tri.v0[a];
+                    }
+                    blocks[b].poly[lane] = tri.poly;
+                }
+
+            std::printf("%-8s %14s %18s\n", "isa", "Mrays/s", "Mtri tests/s");
+            for (auto isa : isas)
+            {
+                if (!thicknessCore::isaSupported(isa))
+                {
+                    std::printf("%-8s %14s\n", thicknessCore::isaName(isa), "unsupported");
+                    continue;
+                }
+
+                const auto kernel = thicknessCore::blockKernel(isa);
+                const auto rate   = throughput(settings,
+                                             shell.rays.size(),
+                                             [&]()
+                                             {
+                                                 uint64_t hits = 0u;
+                                                 for (const auto& ray : shell.rays)
+                                                 {
+                                                     auto closest = std::numeric_limits<float>::max();
+                                                     auto poly    = thicknessCore::invalidIndex;
+                                                     kernel(blocks.data(), blockCount, ray, closest, poly);
+                                                     hits += poly;
+                                                 }
+                                                 keep(hits);
+                                             });
+
+                std::printf("%-8s %14.2f %18.2f\n", thicknessCore::isaName(isa), rate / 1e6, rate * blockCount * thicknessCore::blockWidth / 1e6);
+            }
+        }
+
+        // Whole traversals, one ray at a time, on one thread.
+        void traversal(const Settings& settings, const Shell& shell, thicknessCore::Bvh& bvh)
+        {
+            std::printf("%-8s %14s\n", "isa", "Mrays/s");
+            for (auto isa : isas)
+            {
+                if (!thicknessCore::isaSupported(isa))
+                {
+                    std::printf("%-8s %14s\n", thicknessCore::isaName(isa), "unsupported");
+                    continue;
+                }
+
+                bvh.setIsa(isa);
+                const auto rate = throughput(settings,
+                                             shell.rays.size(),
+                                             [&]()
+                                             {
+                                                 uint64_t           hits = 0u;
+                                                 thicknessCore::Hit hit;
+                                                 for (const auto& ray : shell.rays)
+                                                     hits += bvh.intersect(ray, hit);
+                                                 keep(hits);
+                                             });
+
+                std::printf("%-8s %14.2f\n", thicknessCore::isaName(isa), rate / 1e6);
+            }
+        }
+    }  // namespace
+
+    void thicknessSampling(const Settings& settings)
+    {
+        const auto shell = makeShell(256u);
+
+        thicknessCore::Bvh bvh;
+        bvh.build(shell.tris);
+        std::printf("%zu triangles, %zu polys\n", shell.tris.size(), shell.rays.size());
+
+        // The sample rays of every poly, in the order the evaluator casts them.
+        std::printf("\n-- traversal of the sample rays, single thread\n");
+        std::printf("%-10s %14s %14s %10s\n", "rays/poly", "single Mrays/s", "packet Mrays/s", "speedup");
+        for (auto rays : { 1u, 8u, 32u })
+        {
+            thicknessCore::Sampling sampling;
+            sampling.rays      = rays;
+            sampling.coneAngle = 0.2618f;
+
+            std::vector<thicknessCore::Ray> samples;
+            samples.reserve(shell.rays.size() * rays);
+            for (const auto& ray : shell.rays)
+                for (auto s = 0u; s < rays; ++s)
+                    samples.push_back(thicknessCore::sampleRay(ray, s, sampling));
+
+            const auto single = throughput(settings,
+                                           samples.size(),
+                                           [&]()
+                                           {
+                                               uint64_t           hits = 0u;
+                                               thicknessCore::Hit hit;
+                                               for (const auto& ray : samples)
+                                                   hits += bvh.intersect(ray, hit);
+                                               keep(hits);
+                                           });
+
+            const auto packet = throughput(settings,
+                                           samples.size(),
+                                           [&]()
+                                           {
+                                               uint64_t           hits = 0u;
+                                               thicknessCore::Hit found[thicknessCore::Bvh::packetWidth];
+                                               for (auto i = 0u; i < samples.size(); i += thicknessCore::Bvh::packetWidth)
+                                               {
+                                                   const auto count = std::min<uint32_t>(thicknessCore::Bvh::packetWidth, static_cast<uint32_t>(samples.size() - i));
+                                                   bvh.intersectPacket(&samples[i], count, found);
+                                                   for (auto r = 0u; r < count; ++r)
+                                                       hits += found[r].valid();
+                                               }
+                                               keep(hits);
+                                           });
+
+            std::printf("%-10u %14.2f %14.2f %9.2fx\n", rays, single / 1e6, packet / 1e6, packet / single);
+        }
+
+        // Whole evaluations the way the plugin runs them, over every core.
+        std::printf("\n-- full evaluation including the BVH build, all cores\n");
+        std::printf("%-10s %14s %14s\n", "rays/poly", "Mpolys/s", "Mrays/s");
+        for (auto rays : { 1u, 8u, 32u })
+        {
+            thicknessCore::Sampling sampling;
+            sampling.rays      = rays;
+            sampling.coneAngle = 0.2618f;
+
+            thicknessCore::Evaluator evaluator;
+            const auto               rate = throughput(settings,
+                                                       shell.rays.size(),
+                                                       [&]()
+                                                       {
+                                                           evaluator.evaluate(makeInput(shell), sampling, false);
+                                                           keep(evaluator.lastRayCount());
+                                                       });
+
+            std::printf("%-10u %14.2f %14.2f\n", rays, rate / 1e6, rate * rays / 1e6);
+        }
+    }
+
+    void thicknessKernels(const Settings& settings)
+    {
+        const auto shell = makeShell(512u);
+
+        thicknessCore::Bvh bvh;
+        bvh.build(shell.tris);
+        std::printf("%zu triangles, %zu rays, single thread\n\n", shell.tris.size(), shell.rays.size());
+
+        std::printf("-- leaf kernel, 32 triangles per ray\n");
+        blockKernels(settings, shell);
+
+        std::printf("\n-- bvh traversal\n");
+        traversal(settings, shell, bvh);
+    }
+}  // namespace bench
@@ -0,0 +1,90 @@
+// Runs the core benchmarks.  With no arguments every suite runs, otherwise only the named
+// ones do.
+
+#include "Bench.hxx"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace bench
+{
+    void keep(uint64_t value)
+    {
+        static volatile uint64_t sink = 0u;
+        sink                          = sink + value;
+    }
+}  // namespace bench
+
+namespace
+{
+    struct Suite
+    {
+        const char* name;
+        const char* description;
+        void (*run)(const bench::Settings&);
+    };
+
+    static const Suite suites[] = {
+        { "kernels", "Thickness ray kernels and BVH traversal, rays per second for each ISA", bench::thicknessKernels },
+        { "sampling", "Thickness cone sampling at 1, 8 and 32 rays per poly, single rays against packets", bench::thicknessSampling },
+        { "readers", "Part falloff weight lookups from 1 to 64 threads, locked cache against the weight table", bench::falloffReaders },
+    };
+
+    void printUsage()
+    {
+        std::printf("usage: coreBench [--time <seconds>] [suite]...\n"
+                    "\n"
+                    "  --time <seconds>  Minimum run time of each measurement, 0.25 by default\n"
+                    "\n"
+                    "suites:\n");
+        for (const auto& suite : suites)
+            std::printf("  %-10s %s\n", suite.name, suite.description);
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    bench::Settings           settings;
+    std::vector<const Suite*> selected;
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-h") == 0 || std::strcmp(argv[i], "--help") == 0)
+        {
+            printUsage();
+            return 0;
+        }
+        else if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+            settings.minSeconds = std::max(std::atof(argv[++i]), 0.001);
+        else
+        {
+            const Suite* found{};
+            for (const auto& suite : suites)
+                if (std::strcmp(argv[i], suite.name) == 0)
+                    found = &suite;
+
+            if (!found)
+            {
+                std::fprintf(stderr, "unknown suite '%s'\n", argv[i]);
+                printUsage();
+                return 1;
+            }
+            selected.push_back(found);
+        }
+    }
+
+    if (selected.empty())
+        for (const auto& suite : suites)
+            selected.push_back(&suite);
+
+    for (const auto* suite : selected)
+    {
+        std::printf("== %s\n", suite->name);
+        suite->run(settings);
+        std::printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "FalloffTables.hxx"
+
+#include <algorithm>
+#include <utility>
+
+namespace partCore
+{
+    void FalloffTables::setRouting(const std::vector<uintptr_t>& ids, const std::vector<uint32_t>& layers)
+    {
+        m_layerOf.clear();
+        if (!ids.empty())
+            m_layerOf.build(ids, layers);
+    }
+
+    void FalloffTables::setLayers(std::vector<Layer> layers)
+    {
+        m_layers = std::move(layers);
+    }
+
+    void FalloffTables::setScale(double scale)
+    {
+        m_scale = scale;
+    }
+
+    FalloffTables::Screen* FalloffTables::draw(uintptr_t view, uint64_t key)
+    {
+        // A view is redrawn for all sorts of reasons, and most of them don't move anything.
+        // Whichever render of it is newest decides.
+        auto matches = [&](const Screen& screen) { return screen.view == view; };
+        auto drawn   = std::find_if(m_drawn.begin(), m_drawn.end(), matches);
+        if (drawn == m_drawn.end())
+        {
+            const auto published = std::find_if(m_screens.begin(), m_screens.end(), matches);
+            if (published != m_screens.end() && published->key == key)
+                return nullptr;
+
+            if (m_spare.empty())
+                m_spare.emplace_back();
+            drawn = m_drawn.insert(m_drawn.end(), std::move(m_spare.back()));
+            m_spare.pop_back();
+        }
+        else if (drawn->key == key)
+            return nullptr;
+
+        std::rotate(m_drawn.begin(), drawn, drawn + 1);
+        auto& screen = m_drawn.front();
+        screen.view  = view;
+        screen.key   = key;
+        return &screen;
+    }
+
+    void FalloffTables::publishScreens()
+    {
+        // Oldest first, so the newest ends up at the front.  Whatever they replace goes back
+        // to the draw side, so the next render of a view usually doesn't allocate.
+        for (auto drawn = m_drawn.rbegin(); drawn != m_drawn.rend(); ++drawn)
+        {
+            const auto view = drawn->view;
+            const auto old  = std::find_if(m_screens.begin(), m_screens.end(), [&](const Screen& screen) { return screen.view == view; });
+            if (old != m_screens.end())
+            {
+                m_spare.push_back(std::move(*old));
+                m_screens.erase(old);
+            }
+            m_screens.insert(m_screens.begin(), std::move(*drawn));
+        }
+        m_drawn.clear();
+
+        while (m_screens.size() > maxScreens)
+        {
+            m_spare.push_back(std::move(m_screens.back()));
+            m_screens.pop_back();
+        }
+        if (m_spare.size() > maxScreens)
+            m_spare.resize(maxScreens);
+    }
+
+    void FalloffTables::clearScreens()
+    {
+        m_screens.clear();
+        m_drawn.clear();
+        m_spare.clear();
+    }
+
+    double FalloffTables::weightOf(uintptr_t point) const
+    {
+        // With one layer there's nothing to route.
+        const auto layer = m_layers.size() == 1u ? 0u : m_layerOf.find(point);
+        if (layer >= m_layers.size())
+            return 1.0;
+
+        const auto& data = m_layers[layer];
+        return weightIn(data, data.parts->find(point));
+    }
+
+    double FalloffTables::weightAt(uintptr_t view, int x, int y) const
+    {
+        // One lookup in the view's buffer, then one in the weights.
+        if (m_screens.empty())
+            return 1.0;
+
+        auto screen = std::find_if(m_screens.begin(), m_screens.end(), [&](const Screen& s) { return s.view == view; });
+        if (screen == m_screens.end())
+            screen = m_screens.begin();
+
+        const auto id = screen->ids.at(x, y);
+        if (id == invalidIndex)
+            return 1.0;
+
+        const auto& starts = screen->starts;
+        const auto  layer  = static_cast<uint32_t>(std::upper_bound(starts.begin(), starts.end(), id) - starts.begin()) - 1u;
+        if (layer >= m_layers.size())
+            return 1.0;
+
+        return weightIn(m_layers[layer], id - starts[layer]);
+    }
+}  // namespace partCore
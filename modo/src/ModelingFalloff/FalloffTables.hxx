@@ -0,0 +1,83 @@
+#pragma once
+
+#include "IdBuffer.hxx"
+
+#include <util/IdTable.hxx>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace partCore
+{
+    // Everything the tool's falloff packet reads while it's out: which layer and part a
+    // point is in, the weights of the parts, and which part covers each pixel of the views
+    // drawn.  The SDK types are left out, so it can be exercised without modo.
+    //
+    // The layers, scale and published views are only set while the packet isn't out, and
+    // are only read while it is, so any number of threads can look weights up without
+    // locking.  Views are drawn while it's out though, so they're rendered into a set of
+    // their own and only published with the next update.
+    class FalloffTables
+    {
+    public:
+        // One layer's parts and weights, owned by the packet and kept alive while set.
+        struct Layer
+        {
+            const util::IdTable* parts{};    // Point ids to parts
+            const float*         weights{};  // Unscaled weight of every part
+            uint32_t             count{};    // Parts, and so weights
+        };
+
+        // One view's render.  Ids in the buffer run on from one layer to the next, layer
+        // i's parts starting at starts[i].
+        struct Screen
+        {
+            uintptr_t             view{};
+            uint64_t              key{};  // Where the view put the parts when it was drawn
+            IdBuffer              ids;
+            std::vector<uint32_t> starts;
+        };
+
+        // Enough for every viewport of a full layout, past that the least recent go.
+        static constexpr size_t maxScreens = 8u;
+
+        // Says which layer each point id is in, only needed with more than one layer.
+        void setRouting(const std::vector<uintptr_t>& ids, const std::vector<uint32_t>& layers);
+        void setLayers(std::vector<Layer> layers);
+        void setScale(double scale);
+
+        // Screen to render the view into, with the key it's being drawn for, or nullptr if
+        // the view's newest render, drawn or published, has the same key.  The screen is
+        // the caller's until the next draw or publish.
+        Screen* draw(uintptr_t view, uint64_t key);
+
+        // Moves the views drawn since the last publish in, replacing their older renders,
+        // or drops every render, for when the parts under them have changed.
+        void publishScreens();
+        void clearScreens();
+
+        // Scaled weight of the point's part.  Points that no layer has, or that weren't in
+        // a part when the weights were made, get the full weight.
+        double weightOf(uintptr_t point) const;
+
+        // Scaled weight of the part over the pixel of the view, or the full weight if none
+        // is.  A view that was never drawn uses the one drawn most recently.
+        double weightAt(uintptr_t view, int x, int y) const;
+
+    private:
+        double weightIn(const Layer& layer, uint32_t part) const
+        {
+            // Parts added since the weights were made don't have one yet.
+            return part < layer.count ? layer.weights[part] * m_scale : 1.0;
+        }
+
+        std::vector<Layer> m_layers;
+        util::IdTable      m_layerOf;
+        double             m_scale{ 1.0 };
+
+        std::vector<Screen> m_screens;  // Published, most recently drawn first
+        std::vector<Screen> m_drawn;    // Drawn since, likewise
+        std::vector<Screen> m_spare;    // Old renders, kept for their storage
+    };
+}  // namespace partCore
@@ -0,0 +1,136 @@
+#include "IdBuffer.hxx"
+
+#include <util/Parallel.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace partCore
+{
+    namespace
+    {
+        // Rows per band.  Every band walks the whole triangle list, skipping those outside
+        // it, so bands are kept tall enough that the skipping stays cheap.
+        static constexpr uint32_t bandRows = 32u;
+
+        // Draws the part of the triangle inside rows [rowBegin, rowEnd), testing against
+        // and writing to the depth of the pixels it covers.
+        void drawTriangle(const ScreenTriangle& tri, uint32_t width, uint32_t rowBegin, uint32_t rowEnd, uint32_t* ids, float* depths)
+        {
+            const auto& a = tri.corners[0];
+            const auto& b = tri.corners[1];
+            const auto& c = tri.corners[2];
+
+            const auto area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+            if (!(std::abs(area) > 1e-12f))
+                return;
+
+            const auto lowX  = std::max(std::floor(std::min({ a[0], b[0], c[0] }) - 0.5f), 0.0f);
+            const auto highX = std::min(std::ceil(std::max({ a[0], b[0], c[0] }) - 0.5f), static_cast<float>(width) - 1.0f);
+            const auto lowY  = std::max(std::floor(std::min({ a[1], b[1], c[1] }) - 0.5f), static_cast<float>(rowBegin));
+            const auto highY = std::min(std::ceil(std::max({ a[1], b[1], c[1] }) - 0.5f), static_cast<float>(rowEnd) - 1.0f);
+            if (lowX > highX || lowY > highY)
+                return;
+
+            // Edge functions divided through by the area, so they're the barycentric
+            // weights directly, whichever way round the triangle winds.
+            const auto inv = 1.0f / area;
+            for (auto y = static_cast<uint32_t>(lowY); y <= static_cast<uint32_t>(highY); ++y)
+            {
+                const auto py  = static_cast<float>(y) + 0.5f;
+                auto*      row = ids + static_cast<size_t>(y) * width;
+                auto*      zs  = depths + static_cast<size_t>(y) * width;
+                for (auto x = static_cast<uint32_t>(lowX); x <= static_cast<uint32_t>(highX); ++x)
+                {
+                    const auto px = static_cast<float>(x) + 0.5f;
+                    const auto wa = ((b[0] - px) * (c[1] - py) - (b[1] - py) * (c[0] - px)) * inv;
+                    const auto wb = ((c[0] - px) * (a[1] - py) - (c[1] - py) * (a[0] - px)) * inv;
+                    const auto wc = 1.0f - wa - wb;
+                    if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+                        continue;
+
+                    const auto z = wa * a[2] + wb * b[2] + wc * c[2];
+                    if (z < zs[x])
+                    {
+                        zs[x]  = z;
+                        row[x] = tri.id;
+                    }
+                }
+            }
+        }
+    }  // namespace
+
+    void appendIslandTriangles(const Islands& islands, const MeshInput& mesh, const std::vector<Vec3>& screen, uint32_t firstId, std::vector<ScreenTriangle>& triangles)
+    {
+        auto finite = [&](uint32_t point)
+        {
+            const auto& p = screen[point];
+            return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+        };
+
+        for (auto island = 0u; island < islands.count(); ++island)
+            for (auto i = islands.polyOffsets[island]; i < islands.polyOffsets[island + 1u]; ++i)
+            {
+                const auto poly  = islands.polys[i];
+                const auto first = mesh.polyOffsets[poly];
+                const auto last  = mesh.polyOffsets[poly + 1u];
+                if (last - first < 3u)
+                    continue;
+
+                // Points the view couldn't place, such as those behind a perspective eye,
+                // drop the triangles they're in.
+                const auto p0 = mesh.polyPoints[first];
+                for (auto j = first + 1u; j + 1u < last; ++j)
+                {
+                    const auto p1 = mesh.polyPoints[j];
+                    const auto p2 = mesh.polyPoints[j + 1u];
+                    if (finite(p0) && finite(p1) && finite(p2))
+                        triangles.push_back({ { screen[p0], screen[p1], screen[p2] }, firstId + island });
+                }
+            }
+    }
+
+    void IdBuffer::render(uint32_t width, uint32_t height, const std::vector<ScreenTriangle>& triangles)
+    {
+        m_width  = width;
+        m_height = height;
+        m_ids.assign(static_cast<size_t>(width) * height, invalidIndex);
+        if (m_ids.empty())
+            return;
+
+        // Kept between renders, so redrawing a view of the same size doesn't allocate.
+        m_depths.assign(m_ids.size(), std::numeric_limits<float>::max());
+
+        // Bands never share a pixel, so each writes its own rows without locking, and
+        // triangles go through in order within a band so ties always resolve the same way.
+        const auto bands = (height + bandRows - 1u) / bandRows;
+        parallel::forEach(bands,
+                          1u,
+                          [&](uint32_t band)
+                          {
+                              const auto rowBegin = band * bandRows;
+                              const auto rowEnd   = std::min(rowBegin + bandRows, height);
+                              for (const auto& tri : triangles)
+                                  drawTriangle(tri, width, rowBegin, rowEnd, m_ids.data(), m_depths.data());
+                          });
+    }
+
+    void IdBuffer::clear()
+    {
+        m_ids.clear();
+        m_depths.clear();
+        m_width  = 0u;
+        m_height = 0u;
+    }
+
+    uint32_t IdBuffer::width() const
+    {
+        return m_width;
+    }
+
+    uint32_t IdBuffer::height() const
+    {
+        return m_height;
+    }
+}  // namespace partCore
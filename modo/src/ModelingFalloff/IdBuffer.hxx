@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Islands.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace partCore
+{
+    // A triangle as seen in a view, x and y in pixels and z a depth, smaller being nearer.
+    struct ScreenTriangle
+    {
+        Vec3     corners[3];
+        uint32_t id;
+    };
+
+    // Appends a fan of triangles for every poly of every island, each tagged firstId plus
+    // its island.  screen holds where every point of the mesh lands in the view.
+    void appendIslandTriangles(const Islands& islands, const MeshInput& mesh, const std::vector<Vec3>& screen, uint32_t firstId, std::vector<ScreenTriangle>& triangles);
+
+    // View sized buffer of which id covers each pixel, filled by a plain software
+    // rasterizer so it doesn't need a GL context.  The nearest triangle over a pixel's
+    // center wins.  Rendered once, then only read, so lookups are safe from any number of
+    // threads.
+    class IdBuffer
+    {
+    public:
+        // Rasterizes the triangles into the buffer, replacing what was there, a band of rows
+        // per core.
+        void render(uint32_t width, uint32_t height, const std::vector<ScreenTriangle>& triangles);
+        void clear();
+
+        uint32_t width() const;
+        uint32_t height() const;
+
+        // Id over the pixel, or invalidIndex if nothing covers it or it's off the buffer.
+        uint32_t at(int x, int y) const
+        {
+            if (x < 0 || y < 0 || static_cast<uint32_t>(x) >= m_width || static_cast<uint32_t>(y) >= m_height)
+                return invalidIndex;
+
+            return m_ids[static_cast<size_t>(y) * m_width + static_cast<uint32_t>(x)];
+        }
+
+    private:
+        std::vector<uint32_t> m_ids;
+        std::vector<float>    m_depths;  // Only used while rendering
+        uint32_t              m_width{};
+        uint32_t              m_height{};
+    };
+}  // namespace partCore
@@ -0,0 +1,402 @@
+#include "Islands.hxx"
+
+#include <util/Parallel.hxx>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+namespace partCore
+{
+    namespace
+    {
+        constexpr uint32_t polyGrain   = 4096u;
+        constexpr uint32_t pointGrain  = 16384u;
+        constexpr uint32_t islandGrain = 64u;
+
+        uint64_t pointHash(const MeshInput& mesh, uint32_t point)
+        {
+            uint32_t bits[3];
+            std::memcpy(bits, mesh.positions[point].data(), sizeof(bits));
+
+            auto hash = mixHash(mesh.pointIds.empty() ? point : mesh.pointIds[point]);
+            hash      = mixHash(hash ^ bits[0]);
+            hash      = mixHash(hash ^ bits[1]);
+            hash      = mixHash(hash ^ bits[2]);
+            if (!mesh.selected.empty())
+                hash = mixHash(hash ^ mesh.selected[point]);
+            return hash;
+        }
+
+        // Unit eigenvector for the largest eigenvalue of a symmetric 3x3 matrix, by cyclic
+        // Jacobi rotations.  Zero if the matrix is, as it is for a single point.
+        Vec3 majorAxis(double a[3][3])
+        {
+            double v[3][3]{ { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+
+            const auto scale = std::abs(a[0][0]) + std::abs(a[1][1]) + std::abs(a[2][2]);
+            if (scale == 0.0)
+                return {};
+
+            for (auto sweep = 0u; sweep < 16u; ++sweep)
+            {
+                const auto off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+                if (off <= 1e-24 * scale * scale)
+                    break;
+
+                for (auto p = 0u; p < 2u; ++p)
+                    for (auto q = p + 1u; q < 3u; ++q)
+                    {
+                        if (a[p][q] == 0.0)
+                            continue;
+
+                        // Rotation that zeroes a[p][q], applied as A' = R^T A R, and gathered
+                        // into the eigenvectors as V' = V R.
+                        const auto theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                        const auto t     = (theta < 0.0 ? -1.0 : 1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                        const auto c     = 1.0 / std::sqrt(t * t + 1.0);
+                        const auto s     = t * c;
+                        for (auto k = 0u; k < 3u; ++k)
+                        {
+                            const auto kp = a[k][p];
+                            const auto kq = a[k][q];
+                            a[k][p]       = c * kp - s * kq;
+                            a[k][q]       = s * kp + c * kq;
+                        }
+                        for (auto k = 0u; k < 3u; ++k)
+                        {
+                            const auto pk = a[p][k];
+                            const auto qk = a[q][k];
+                            a[p][k]       = c * pk - s * qk;
+                            a[q][k]       = s * pk + c * qk;
+                        }
+                        for (auto k = 0u; k < 3u; ++k)
+                        {
+                            const auto kp = v[k][p];
+                            const auto kq = v[k][q];
+                            v[k][p]       = c * kp - s * kq;
+                            v[k][q]       = s * kp + c * kq;
+                        }
+                    }
+            }
+
+            auto major = 0u;
+            for (auto i = 1u; i < 3u; ++i)
+                if (a[i][i] > a[major][major])
+                    major = i;
+
+            return { static_cast<float>(v[0][major]), static_cast<float>(v[1][major]), static_cast<float>(v[2][major]) };
+        }
+
+        // Works out everything kept per island from its points and polys.  Islands don't
+        // share anything, so any number of them can be measured at once.
+        void measureIsland(Islands& islands, const MeshInput& mesh, uint32_t island)
+        {
+            const auto first = islands.offsets[island];
+            const auto last  = islands.offsets[island + 1u];
+
+            // One pass gathers the sums for the mean and the covariance together.  They're
+            // taken relative to the first point, which keeps them small for parts far from
+            // the origin.
+            const Vec3 base = mesh.positions[islands.points[first]];
+            double     sum[3]{};
+            double     products[3][3]{};
+            Vec3       lo        = base;
+            Vec3       hi        = lo;
+            auto       selected  = false;
+            uint64_t   signature = 0u;
+            for (auto i = first; i < last; ++i)
+            {
+                const auto  point = islands.points[i];
+                const auto& p     = mesh.positions[point];
+
+                const double d[3]{ double(p[0]) - base[0], double(p[1]) - base[1], double(p[2]) - base[2] };
+                for (auto a = 0u; a < 3u; ++a)
+                {
+                    sum[a] += d[a];
+                    for (auto b = a; b < 3u; ++b)
+                        products[a][b] += d[a] * d[b];
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+
+                selected = selected || (!mesh.selected.empty() && mesh.selected[point] != 0u);
+
+                // Summed, so it doesn't matter what order the points are visited in.
+                signature += pointHash(mesh, point);
+            }
+
+            const double count = last - first;
+            const double mean[3]{ sum[0] / count, sum[1] / count, sum[2] / count };
+            const Vec3   center = { static_cast<float>(base[0] + mean[0]), static_cast<float>(base[1] + mean[1]), static_cast<float>(base[2] + mean[2]) };
+
+            double covariance[3][3];
+            for (auto a = 0u; a < 3u; ++a)
+                for (auto b = a; b < 3u; ++b)
+                    covariance[a][b] = covariance[b][a] = products[a][b] / count - mean[a] * mean[b];
+
+            islands.centers.set(island, center);
+            islands.axes.set(island, majorAxis(covariance));
+            islands.boundsMin.set(island, lo);
+            islands.boundsMax.set(island, hi);
+            islands.selected[island]   = selected;
+            islands.signatures[island] = signature;
+
+            // Each poly's area and its share of the enclosed volume, taken about the center
+            // to keep the volume's sums small.
+            double area{};
+            double volume{};
+            for (auto i = islands.polyOffsets[island]; i < islands.polyOffsets[island + 1u]; ++i)
+            {
+                const auto poly      = islands.polys[i];
+                const auto polyFirst = mesh.polyOffsets[poly];
+                const auto polyLast  = mesh.polyOffsets[poly + 1u];
+                if (polyLast - polyFirst < 3u)
+                    continue;
+
+                auto local = [&](uint32_t v)
+                {
+                    const auto& p = mesh.positions[mesh.polyPoints[v]];
+                    return std::array<double, 3>{ double(p[0]) - center[0], double(p[1]) - center[1], double(p[2]) - center[2] };
+                };
+
+                // Fan out from the first point.  The summed cross products give the poly's
+                // normal scaled by twice its area.
+                const auto origin = local(polyFirst);
+                double     normal[3]{};
+                auto       prev = local(polyFirst + 1u);
+                for (auto v = polyFirst + 2u; v < polyLast; ++v)
+                {
+                    const auto   next = local(v);
+                    const double a[3]{ prev[0] - origin[0], prev[1] - origin[1], prev[2] - origin[2] };
+                    const double b[3]{ next[0] - origin[0], next[1] - origin[1], next[2] - origin[2] };
+                    const double c[3]{ a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+                    for (auto k = 0u; k < 3u; ++k)
+                        normal[k] += c[k];
+                    volume += (origin[0] * c[0] + origin[1] * c[1] + origin[2] * c[2]) / 6.0;
+                    prev = next;
+                }
+
+                area += 0.5 * std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            }
+
+            islands.area[island]   = static_cast<float>(area);
+            islands.volume[island] = static_cast<float>(std::abs(volume));
+        }
+
+        // Lock free union-find.  Roots are only ever linked to a lower index, so every parent
+        // is at or below its child, the structure can't cycle, and each island ends up rooted
+        // at its lowest point whatever order the unions ran in.
+        class DisjointSets
+        {
+        public:
+            explicit DisjointSets(uint32_t count) : m_parents(new std::atomic<uint32_t>[count])
+            {
+                parallel::forEach(count, pointGrain, [&](uint32_t i) { m_parents[i].store(i, std::memory_order_relaxed); });
+            }
+
+            uint32_t find(uint32_t x) const
+            {
+                // Path halving.  A failed exchange just means another thread got there first.
+                for (;;)
+                {
+                    auto parent = m_parents[x].load(std::memory_order_relaxed);
+                    if (parent == x)
+                        return x;
+
+                    const auto grandParent = m_parents[parent].load(std::memory_order_relaxed);
+                    if (parent != grandParent)
+                        m_parents[x].compare_exchange_weak(parent, grandParent, std::memory_order_relaxed);
+                    x = grandParent;
+                }
+            }
+
+            void unite(uint32_t a, uint32_t b)
+            {
+                for (;;)
+                {
+                    a = find(a);
+                    b = find(b);
+                    if (a == b)
+                        return;
+
+                    if (a < b)
+                        std::swap(a, b);
+
+                    // Only succeeds if a is still a root, otherwise go round with the new roots.
+                    auto expected = a;
+                    if (m_parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+                        return;
+                }
+            }
+
+        private:
+            std::unique_ptr<std::atomic<uint32_t>[]> m_parents;
+        };
+    }  // namespace
+
+    Islands findIslands(const MeshInput& mesh)
+    {
+        Islands islands;
+
+        const auto pointCount = static_cast<uint32_t>(mesh.positions.size());
+        const auto polyCount  = mesh.polyOffsets.empty() ? 0u : static_cast<uint32_t>(mesh.polyOffsets.size() - 1u);
+        if (pointCount == 0u)
+            return islands;
+
+        DisjointSets sets(pointCount);
+        parallel::forEach(polyCount,
+                          polyGrain,
+                          [&](uint32_t poly)
+                          {
+                              const auto first = mesh.polyOffsets[poly];
+                              const auto last  = mesh.polyOffsets[poly + 1u];
+                              for (auto i = first + 1u; i < last; ++i)
+                                  sets.unite(mesh.polyPoints[first], mesh.polyPoints[i]);
+                          });
+
+        // Every root is the lowest point of its island, so numbering the roots in index
+        // order gives the stable ids.  Each chunk counts its roots, and a prefix over the
+        // chunks says where its numbering starts.
+        auto& pointIsland = islands.pointIsland;
+        pointIsland.resize(pointCount);
+
+        std::vector<uint32_t> roots(pointCount);
+        std::vector<uint32_t> chunkRoots(parallel::chunkCount(pointCount, pointGrain) + 1u, 0u);
+        parallel::forChunks(pointCount,
+                            pointGrain,
+                            [&](uint32_t chunk, uint32_t begin, uint32_t end, uint32_t)
+                            {
+                                auto count = 0u;
+                                for (auto i = begin; i < end; ++i)
+                                {
+                                    roots[i] = sets.find(i);
+                                    count += roots[i] == i;
+                                }
+                                chunkRoots[chunk + 1u] = count;
+                            });
+
+        for (auto i = 1u; i < chunkRoots.size(); ++i)
+            chunkRoots[i] += chunkRoots[i - 1u];
+
+        const auto islandCount = chunkRoots.back();
+        parallel::forChunks(pointCount,
+                            pointGrain,
+                            [&](uint32_t chunk, uint32_t begin, uint32_t end, uint32_t)
+                            {
+                                auto next = chunkRoots[chunk];
+                                for (auto i = begin; i < end; ++i)
+                                    if (roots[i] == i)
+                                        pointIsland[i] = next++;
+                            });
+
+        // Only the non-root entries are written here, and only root entries are read.
+        parallel::forEach(pointCount,
+                          pointGrain,
+                          [&](uint32_t i)
+                          {
+                              if (roots[i] != i)
+                                  pointIsland[i] = pointIsland[roots[i]];
+                          });
+
+        // Counting sort of the points by island.  Scanning in index order keeps each
+        // island's points sorted.
+        auto& offsets = islands.offsets;
+        offsets.assign(islandCount + 1u, 0u);
+        for (auto i = 0u; i < pointCount; ++i)
+            ++offsets[pointIsland[i] + 1u];
+        for (auto i = 1u; i <= islandCount; ++i)
+            offsets[i] += offsets[i - 1u];
+
+        islands.points.resize(pointCount);
+        {
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (auto i = 0u; i < pointCount; ++i)
+                islands.points[cursor[pointIsland[i]]++] = i;
+        }
+
+        // Same again for the polys, by the island of their first point, so each island's
+        // measures can be worked out on their own.
+        auto& polyOffsets = islands.polyOffsets;
+        polyOffsets.assign(islandCount + 1u, 0u);
+        for (auto poly = 0u; poly < polyCount; ++poly)
+            if (mesh.polyOffsets[poly] != mesh.polyOffsets[poly + 1u])
+                ++polyOffsets[pointIsland[mesh.polyPoints[mesh.polyOffsets[poly]]] + 1u];
+        for (auto i = 1u; i <= islandCount; ++i)
+            polyOffsets[i] += polyOffsets[i - 1u];
+
+        islands.polys.resize(polyOffsets.back());
+        {
+            std::vector<uint32_t> cursor(polyOffsets.begin(), polyOffsets.end() - 1);
+            for (auto poly = 0u; poly < polyCount; ++poly)
+                if (mesh.polyOffsets[poly] != mesh.polyOffsets[poly + 1u])
+                    islands.polys[cursor[pointIsland[mesh.polyPoints[mesh.polyOffsets[poly]]]]++] = poly;
+        }
+
+        islands.centers.resize(islandCount);
+        islands.boundsMin.resize(islandCount);
+        islands.boundsMax.resize(islandCount);
+        islands.axes.resize(islandCount);
+        islands.area.resize(islandCount);
+        islands.volume.resize(islandCount);
+        islands.selected.resize(islandCount);
+        islands.signatures.resize(islandCount);
+        parallel::forEach(islandCount, islandGrain, [&](uint32_t island) { measureIsland(islands, mesh, island); });
+
+        return islands;
+    }
+
+    uint64_t topologyHash(const MeshInput& mesh)
+    {
+        // Each chunk of the poly points is hashed on its own, then the chunks are chained in
+        // order along with the point ids and poly sizes.
+        const auto pointCount = static_cast<uint32_t>(mesh.polyPoints.size());
+
+        std::vector<uint64_t> chunkHashes(parallel::chunkCount(pointCount, pointGrain), 0u);
+        parallel::forChunks(pointCount,
+                            pointGrain,
+                            [&](uint32_t chunk, uint32_t begin, uint32_t end, uint32_t)
+                            {
+                                auto hash = static_cast<uint64_t>(begin);
+                                for (auto i = begin; i < end; ++i)
+                                    hash = mixHash(hash ^ mesh.polyPoints[i]);
+                                chunkHashes[chunk] = hash;
+                            });
+
+        auto hash = mixHash(mesh.positions.size());
+        for (auto chunkHash : chunkHashes)
+            hash = mixHash(hash ^ chunkHash);
+        for (auto offset : mesh.polyOffsets)
+            hash = mixHash(hash ^ offset);
+        for (auto id : mesh.pointIds)
+            hash = mixHash(hash ^ id);
+        return hash;
+    }
+
+    std::vector<uint32_t> refreshIslands(Islands& islands, const MeshInput& mesh)
+    {
+        const auto islandCount = islands.count();
+
+        std::vector<uint8_t> changed(islandCount, 0u);
+        parallel::forEach(islandCount,
+                          islandGrain,
+                          [&](uint32_t island)
+                          {
+                              auto signature = uint64_t{};
+                              for (auto i = islands.offsets[island]; i < islands.offsets[island + 1u]; ++i)
+                                  signature += pointHash(mesh, islands.points[i]);
+                              changed[island] = signature != islands.signatures[island];
+                          });
+
+        std::vector<uint32_t> dirty;
+        for (auto i = 0u; i < islandCount; ++i)
+            if (changed[i])
+                dirty.push_back(i);
+
+        parallel::forEach(static_cast<uint32_t>(dirty.size()), islandGrain, [&](uint32_t i) { measureIsland(islands, mesh, dirty[i]); });
+        return dirty;
+    }
+}  // namespace partCore
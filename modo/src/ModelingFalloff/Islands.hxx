@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Mesh island finding for the part falloff.  The islands come straight from the poly
+// connectivity, so they're right even when the mesh's own part tags are out of date.
+// Nothing in here touches the SDK, so it can be fed synthetic meshes outside of modo.
+namespace partCore
+{
+    using Vec3 = std::array<float, 3>;
+
+    static constexpr uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+
+    // splitmix64's finalizer, enough to spread ids and float bits over the whole hash.
+    // Hashes are built up by mixing each value in, hash = mixHash(hash ^ value).
+    inline uint64_t mixHash(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    // Vectors stored as one array per axis, so loops over every part run straight down
+    // each array.
+    struct Vec3Array
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+
+        uint32_t size() const
+        {
+            return static_cast<uint32_t>(x.size());
+        }
+
+        void resize(uint32_t count)
+        {
+            x.resize(count);
+            y.resize(count);
+            z.resize(count);
+        }
+
+        Vec3 get(uint32_t i) const
+        {
+            return { x[i], y[i], z[i] };
+        }
+
+        void set(uint32_t i, const Vec3& v)
+        {
+            x[i] = v[0];
+            y[i] = v[1];
+            z[i] = v[2];
+        }
+    };
+
+    // Flat copy of the mesh.  Polys are runs of point indices, poly i uses
+    // polyPoints[polyOffsets[i], polyOffsets[i + 1]).  The point ids are whatever the
+    // caller uses to identify points, and are optional.  So is the selection, non-zero for
+    // every selected point, the caller folds any other selection down to its points.
+    struct MeshInput
+    {
+        std::vector<Vec3>      positions;
+        std::vector<uintptr_t> pointIds;
+        std::vector<uint32_t>  polyOffsets;
+        std::vector<uint32_t>  polyPoints;
+        std::vector<uint8_t>   selected;
+    };
+
+    // Islands get dense ids in the order of their lowest point index, so the same mesh
+    // always gives the same ids.  A point that no poly uses is an island on its own.
+    struct Islands
+    {
+        std::vector<uint32_t> pointIsland;  // Island id for every point
+
+        // The points of island i are points[offsets[i], offsets[i + 1]), in index order.
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> points;
+
+        // Likewise its polys, by the island of their first point.  Empty polys are left out.
+        std::vector<uint32_t> polyOffsets;
+        std::vector<uint32_t> polys;
+
+        // Per island, the mean of its points and their bounds.
+        Vec3Array centers;
+        Vec3Array boundsMin;
+        Vec3Array boundsMax;
+
+        // Per island, the unit direction its points spread furthest along, from the
+        // covariance of the points.  Its sign is arbitrary, and it's zero for an island
+        // whose points all sit together.
+        Vec3Array axes;
+
+        // Per island measures for the falloff modes.  The area is the sum of its polys'
+        // areas, and the volume is what those polys enclose, so only means much for closed
+        // islands.  An island is selected if any of its points are.
+        std::vector<float>   area;
+        std::vector<float>   volume;
+        std::vector<uint8_t> selected;
+
+        // Order independent hash of each island's point ids, positions and selection, to
+        // tell which islands changed since they were measured.
+        std::vector<uint64_t> signatures;
+
+        uint32_t count() const
+        {
+            return centers.size();
+        }
+
+        uint32_t pointCount(uint32_t island) const
+        {
+            return offsets[island + 1u] - offsets[island];
+        }
+    };
+
+    // Unions the points of every poly together over every core, then gathers the islands
+    // and their centers, bounds and measures.
+    Islands findIslands(const MeshInput& mesh);
+
+    // Hash of the mesh's point ids and polys, ignoring positions and selection.  Islands
+    // found from a mesh stay valid for any mesh with the same topology hash.
+    uint64_t topologyHash(const MeshInput& mesh);
+
+    // Measures again just the islands whose points moved or changed selection, and
+    // returns them in order.  The mesh must have the topology the islands were found from.
+    std::vector<uint32_t> refreshIslands(Islands& islands, const MeshInput& mesh);
+}  // namespace partCore
@@ -0,0 +1,102 @@
+#include "KdTree.hxx"
+
+#include <algorithm>
+#include <limits>
+
+namespace partCore
+{
+    void KdTree::build(const Vec3Array& points, const std::vector<uint32_t>& indices)
+    {
+        m_nodes.resize(indices.size());
+        for (auto i = 0u; i < indices.size(); ++i)
+            m_nodes[i] = { points.get(indices[i]), indices[i], 0u };
+
+        buildRange(0u, static_cast<uint32_t>(m_nodes.size()));
+    }
+
+    void KdTree::clear()
+    {
+        m_nodes.clear();
+    }
+
+    bool KdTree::empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    void KdTree::buildRange(uint32_t begin, uint32_t end)
+    {
+        if (end - begin < 2u)
+            return;
+
+        // Split on the widest axis of the range, which copes with flat or lined up parts
+        // better than cycling through the axes.
+        Vec3 lo = m_nodes[begin].pos;
+        Vec3 hi = lo;
+        for (auto i = begin + 1u; i < end; ++i)
+            for (auto a = 0u; a < 3u; ++a)
+            {
+                lo[a] = std::min(lo[a], m_nodes[i].pos[a]);
+                hi[a] = std::max(hi[a], m_nodes[i].pos[a]);
+            }
+
+        auto axis = 0u;
+        for (auto a = 1u; a < 3u; ++a)
+            if (hi[a] - lo[a] > hi[axis] - lo[axis])
+                axis = a;
+
+        const auto mid = begin + (end - begin) / 2u;
+        std::nth_element(m_nodes.begin() + begin,
+                         m_nodes.begin() + mid,
+                         m_nodes.begin() + end,
+                         [axis](const Node& a, const Node& b) { return a.pos[axis] < b.pos[axis]; });
+        m_nodes[mid].axis = axis;
+
+        buildRange(begin, mid);
+        buildRange(mid + 1u, end);
+    }
+
+    uint32_t KdTree::nearest(const Vec3& pos, float& distSq) const
+    {
+        auto best = invalidIndex;
+        distSq    = std::numeric_limits<float>::max();
+        searchRange(0u, static_cast<uint32_t>(m_nodes.size()), pos, best, distSq);
+        return best;
+    }
+
+    void KdTree::searchRange(uint32_t begin, uint32_t end, const Vec3& pos, uint32_t& best, float& bestDistSq) const
+    {
+        if (begin >= end)
+            return;
+
+        const auto  mid  = begin + (end - begin) / 2u;
+        const auto& node = m_nodes[mid];
+
+        const float d[3]{ pos[0] - node.pos[0], pos[1] - node.pos[1], pos[2] - node.pos[2] };
+        const auto  distSq = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        if (distSq < bestDistSq)
+        {
+            bestDistSq = distSq;
+            best       = node.index;
+        }
+
+        if (end - begin == 1u)
+            return;
+
+        // Near side first, then the far side only if the splitting plane is closer than
+        // the best so far.
+        const auto split = d[node.axis];
+        if (split < 0.0f)
+        {
+            searchRange(begin, mid, pos, best, bestDistSq);
+            if (split * split < bestDistSq)
+                searchRange(mid + 1u, end, pos, best, bestDistSq);
+        }
+        else
+        {
+            searchRange(mid + 1u, end, pos, best, bestDistSq);
+            if (split * split < bestDistSq)
+                searchRange(begin, mid, pos, best, bestDistSq);
+        }
+    }
+}  // namespace partCore
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Islands.hxx"
+
+#include <cstdint>
+#include <vector>
+
+namespace partCore
+{
+    // Balanced kd-tree over a set of points, for finding the closest one to many queries.
+    // The tree is stored implicitly, each range's median node sits in the middle of the
+    // range with the halves either side, so there are no child links to follow.  Built
+    // once, then only read, so queries are safe from any number of threads.
+    class KdTree
+    {
+    public:
+        // Builds over points[indices], queries then answer with those indices.
+        void build(const Vec3Array& points, const std::vector<uint32_t>& indices);
+        void clear();
+
+        bool empty() const;
+
+        // Index of the closest point and its squared distance, or invalidIndex for an
+        // empty tree.
+        uint32_t nearest(const Vec3& pos, float& distSq) const;
+
+    private:
+        struct Node
+        {
+            Vec3     pos;
+            uint32_t index;
+            uint32_t axis;
+        };
+
+        void buildRange(uint32_t begin, uint32_t end);
+        void searchRange(uint32_t begin, uint32_t end, const Vec3& pos, uint32_t& best, float& bestDistSq) const;
+
+        std::vector<Node> m_nodes;
+    };
+}  // namespace partCore
@@ -0,0 +1,125 @@
+#include "Kernels.hxx"
+
+#include <util/Simd.hxx>
+
+#include <algorithm>
+
+namespace partCore
+{
+    namespace
+    {
+        void gatherScalar(const float* table, uint32_t tableCount, const uint32_t* parts, uint32_t count, float scale, float* weights)
+        {
+            for (auto i = 0u; i < count; ++i)
+                weights[i] = parts[i] < tableCount ? table[parts[i]] * scale : 1.0f;
+        }
+
+        void projectScalar(const float* x, const float* y, const float* z, uint32_t count, const float* origin, const float* dir, float* values)
+        {
+            for (auto i = 0u; i < count; ++i)
+            {
+                const float along = (x[i] - origin[0]) * dir[0] + (y[i] - origin[1]) * dir[1] + (z[i] - origin[2]) * dir[2];
+                values[i]         = std::min(std::max(0.0f, along), 1.0f);
+            }
+        }
+
+#ifdef SIMD_X86
+        SIMD_TARGET("avx2")
+        void gatherAvx2(const float* table, uint32_t tableCount, const uint32_t* parts, uint32_t count, float scale, float* weights)
+        {
+            if (tableCount == 0u)
+            {
+                gatherScalar(table, tableCount, parts, count, scale, weights);
+                return;
+            }
+
+            // There's no unsigned compare, but a part is in range exactly when clamping it
+            // to the last entry leaves it alone.  Out of range lanes are masked off the gather,
+            // so they never touch memory.
+            const __m256i last = _mm256_set1_epi32(static_cast<int>(tableCount - 1u));
+            const __m256  ones = _mm256_set1_ps(1.0f);
+            const __m256  scl  = _mm256_set1_ps(scale);
+
+            auto i = 0u;
+            for (; i + 8u <= count; i += 8u)
+            {
+                const __m256i idx     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(parts + i));
+                const __m256  inRange = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_min_epu32(idx, last), idx));
+                const __m256  w       = _mm256_mask_i32gather_ps(ones, table, idx, inRange, 4);
+                _mm256_storeu_ps(weights + i, _mm256_blendv_ps(ones, _mm256_mul_ps(w, scl), inRange));
+            }
+            gatherScalar(table, tableCount, parts + i, count - i, scale, weights + i);
+        }
+
+        // Separate multiplies and adds rather than fma, to match the scalar kernel.
+        SIMD_TARGET("avx2")
+        void projectAvx2(const float* x, const float* y, const float* z, uint32_t count, const float* origin, const float* dir, float* values)
+        {
+            const __m256 ox = _mm256_set1_ps(origin[0]);
+            const __m256 oy = _mm256_set1_ps(origin[1]);
+            const __m256 oz = _mm256_set1_ps(origin[2]);
+            const __m256 dx = _mm256_set1_ps(dir[0]);
+            const __m256 dy = _mm256_set1_ps(dir[1]);
+            const __m256 dz = _mm256_set1_ps(dir[2]);
+
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 one  = _mm256_set1_ps(1.0f);
+
+            auto i = 0u;
+            for (; i + 8u <= count; i += 8u)
+            {
+                const __m256 px = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), ox), dx);
+                const __m256 py = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(y + i), oy), dy);
+                const __m256 pz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(z + i), oz), dz);
+                const __m256 along = _mm256_add_ps(_mm256_add_ps(px, py), pz);
+                _mm256_storeu_ps(values + i, _mm256_min_ps(_mm256_max_ps(along, zero), one));
+            }
+            projectScalar(x + i, y + i, z + i, count - i, origin, dir, values + i);
+        }
+
+#endif
+    }  // namespace
+
+    const char* isaName(Isa isa)
+    {
+        return isa == Isa::avx2 ? "avx2" : "scalar";
+    }
+
+    bool isaSupported(Isa isa)
+    {
+#ifdef SIMD_X86
+        return isa == Isa::avx2 ? simd::cpuFeatures().avx2 : true;
+#else
+        return isa == Isa::scalar;
+#endif
+    }
+
+    Isa bestIsa()
+    {
+        return isaSupported(Isa::avx2) ? Isa::avx2 : Isa::scalar;
+    }
+
+    GatherKernel gatherKernel(Isa isa)
+    {
+        if (!isaSupported(isa))
+            isa = bestIsa();
+
+#ifdef SIMD_X86
+        if (isa == Isa::avx2)
+            return gatherAvx2;
+#endif
+        return gatherScalar;
+    }
+
+    ProjectKernel projectKernel(Isa isa)
+    {
+        if (!isaSupported(isa))
+            isa = bestIsa();
+
+#ifdef SIMD_X86
+        if (isa == Isa::avx2)
+            return projectAvx2;
+#endif
+        return projectScalar;
+    }
+}  // namespace partCore
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// SIMD kernels for the per part falloff work.  The AVX2 versions are compiled in alongside
+// the scalar ones and picked at runtime, so the plugin still loads on older machines.
+namespace partCore
+{
+    enum class Isa : uint32_t
+    {
+        scalar,
+        avx2
+    };
+
+    const char* isaName(Isa isa);
+    bool        isaSupported(Isa isa);
+    Isa         bestIsa();
+
+    // Writes table[parts[i]] * scale for every part in the run.  Parts past the end of the
+    // table, such as points the table was built without, get a weight of 1, unscaled.
+    using GatherKernel = void (*)(const float* table, uint32_t tableCount, const uint32_t* parts, uint32_t count, float scale, float* weights);
+
+    // Returns the kernel for the given instruction set, falling back to the best
+    // supported one if the cpu can't run it.
+    GatherKernel gatherKernel(Isa isa);
+
+    // Writes dot(p - origin, dir) for a run of points given one array per axis, which is
+    // how far along dir each point sits, clamped to [0, 1].  Both kernels give exactly the
+    // same values.
+    using ProjectKernel = void (*)(const float* x, const float* y, const float* z, uint32_t count, const float* origin, const float* dir, float* values);
+
+    ProjectKernel projectKernel(Isa isa);
+}  // namespace partCore
@@ -0,0 +1,288 @@
+#include "Noise.hxx"
+
+#include <util/Simd.hxx>
+
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+
+namespace partCore
+{
+    namespace
+    {
+        constexpr int32_t sampleMask    = GradientNoise::samples - 1u;
+        constexpr float   latticeOffset = 4096.0f;  // Keeps the truncation below on positive values
+
+        struct NoiseParams
+        {
+            const int32_t* perm;
+            const float*   gradX;
+            const float*   gradY;
+            const float*   gradZ;
+            uint32_t       octaves;
+            float          frequency;
+            float          amplitude;
+        };
+
+        // The SIMD version below follows the exact same order of operations as these, which
+        // in turn follow CLxPerlin's.
+        inline float sCurve(float t)
+        {
+            return t * t * (3.0f - 2.0f * t);
+        }
+
+        inline float lerp(float t, float a, float b)
+        {
+            return a + t * (b - a);
+        }
+
+        inline float dot(const NoiseParams& params, int32_t index, float rx, float ry, float rz)
+        {
+            return rx * params.gradX[index] + ry * params.gradY[index] + rz * params.gradZ[index];
+        }
+
+        float octaveScalar(const NoiseParams& params, float x, float y, float z)
+        {
+            const float tx = x + latticeOffset;
+            const float ty = y + latticeOffset;
+            const float tz = z + latticeOffset;
+
+            const int32_t bx0 = static_cast<int32_t>(tx) & sampleMask;
+            const int32_t by0 = static_cast<int32_t>(ty) & sampleMask;
+            const int32_t bz0 = static_cast<int32_t>(tz) & sampleMask;
+            const int32_t bx1 = (bx0 + 1) & sampleMask;
+            const int32_t by1 = (by0 + 1) & sampleMask;
+            const int32_t bz1 = (bz0 + 1) & sampleMask;
+
+            const float rx0 = tx - static_cast<float>(static_cast<int32_t>(tx));
+            const float ry0 = ty - static_cast<float>(static_cast<int32_t>(ty));
+            const float rz0 = tz - static_cast<float>(static_cast<int32_t>(tz));
+            const float rx1 = rx0 - 1.0f;
+            const float ry1 = ry0 - 1.0f;
+            const float rz1 = rz0 - 1.0f;
+
+            const int32_t* p   = params.perm;
+            const int32_t  i   = p[bx0];
+            const int32_t  j   = p[bx1];
+            const int32_t  b00 = p[i + by0];
+            const int32_t  b10 = p[j + by0];
+            const int32_t  b01 = p[i + by1];
+            const int32_t  b11 = p[j + by1];
+
+            const float sx = sCurve(rx0);
+            const float sy = sCurve(ry0);
+            const float sz = sCurve(rz0);
+
+            const float c = lerp(sy,
+                                 lerp(sx, dot(params, b00 + bz0, rx0, ry0, rz0), dot(params, b10 + bz0, rx1, ry0, rz0)),
+                                 lerp(sx, dot(params, b01 + bz0, rx0, ry1, rz0), dot(params, b11 + bz0, rx1, ry1, rz0)));
+            const float d = lerp(sy,
+                                 lerp(sx, dot(params, b00 + bz1, rx0, ry0, rz1), dot(params, b10 + bz1, rx1, ry0, rz1)),
+                                 lerp(sx, dot(params, b01 + bz1, rx0, ry1, rz1), dot(params, b11 + bz1, rx1, ry1, rz1)));
+            return lerp(sz, c, d);
+        }
+
+        float evalScalar(const NoiseParams& params, float x, float y, float z)
+        {
+            float result    = 0.0f;
+            float amplitude = params.amplitude;
+            x *= params.frequency;
+            y *= params.frequency;
+            z *= params.frequency;
+            for (auto o = 0u; o < params.octaves; ++o)
+            {
+                result += octaveScalar(params, x, y, z) * amplitude;
+                x *= 2.0f;
+                y *= 2.0f;
+                z *= 2.0f;
+                amplitude *= 0.5f;
+            }
+            return result;
+        }
+
+        void runScalar(const NoiseParams& params, const float* x, const float* y, const float* z, uint32_t count, float* values)
+        {
+            for (auto i = 0u; i < count; ++i)
+                values[i] = evalScalar(params, x[i], y[i], z[i]);
+        }
+
+#ifdef SIMD_X86
+        SIMD_TARGET("avx2")
+        inline __m256 sCurveAvx2(__m256 t)
+        {
+            const __m256 inner = _mm256_sub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(_mm256_set1_ps(2.0f), t));
+            return _mm256_mul_ps(_mm256_mul_ps(t, t), inner);
+        }
+
+        SIMD_TARGET("avx2")
+        inline __m256 lerpAvx2(__m256 t, __m256 a, __m256 b)
+        {
+            return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+        }
+
+        SIMD_TARGET("avx2")
+        inline __m256 dotAvx2(const NoiseParams& params, __m256i index, __m256 rx, __m256 ry, __m256 rz)
+        {
+            const __m256 x = _mm256_mul_ps(rx, _mm256_i32gather_ps(params.gradX, index, 4));
+            const __m256 y = _mm256_mul_ps(ry, _mm256_i32gather_ps(params.gradY, index, 4));
+            const __m256 z = _mm256_mul_ps(rz, _mm256_i32gather_ps(params.gradZ, index, 4));
+            return _mm256_add_ps(_mm256_add_ps(x, y), z);
+        }
+
+        SIMD_TARGET("avx2")
+        __m256 octaveAvx2(const NoiseParams& params, __m256 x, __m256 y, __m256 z)
+        {
+            const __m256  offset = _mm256_set1_ps(latticeOffset);
+            const __m256  one    = _mm256_set1_ps(1.0f);
+            const __m256i mask   = _mm256_set1_epi32(sampleMask);
+            const __m256i step   = _mm256_set1_epi32(1);
+
+            const __m256 tx = _mm256_add_ps(x, offset);
+            const __m256 ty = _mm256_add_ps(y, offset);
+            const __m256 tz = _mm256_add_ps(z, offset);
+
+            const __m256i ix = _mm256_cvttps_epi32(tx);
+            const __m256i iy = _mm256_cvttps_epi32(ty);
+            const __m256i iz = _mm256_cvttps_epi32(tz);
+
+            const __m256i bx0 = _mm256_and_si256(ix, mask);
+            const __m256i by0 = _mm256_and_si256(iy, mask);
+            const __m256i bz0 = _mm256_and_si256(iz, mask);
+            const __m256i bx1 = _mm256_and_si256(_mm256_add_epi32(bx0, step), mask);
+            const __m256i by1 = _mm256_and_si256(_mm256_add_epi32(by0, step), mask);
+            const __m256i bz1 = _mm256_and_si256(_mm256_add_epi32(bz0, step), mask);
+
+            const __m256 rx0 = _mm256_sub_ps(tx, _mm256_cvtepi32_ps(ix));
+            const __m256 ry0 = _mm256_sub_ps(ty, _mm256_cvtepi32_ps(iy));
+            const __m256 rz0 = _mm256_sub_ps(tz, _mm256_cvtepi32_ps(iz));
+            const __m256 rx1 = _mm256_sub_ps(rx0, one);
+            const __m256 ry1 = _mm256_sub_ps(ry0, one);
+            const __m256 rz1 = _mm256_sub_ps(rz0, one);
+
+            const int32_t* p   = params.perm;
+            const __m256i  i   = _mm256_i32gather_epi32(p, bx0, 4);
+            const __m256i  j   = _mm256_i32gather_epi32(p, bx1, 4);
+            const __m256i  b00 = _mm256_i32gather_epi32(p, _mm256_add_epi32(i, by0), 4);
+            const __m256i  b10 = _mm256_i32gather_epi32(p, _mm256_add_epi32(j, by0), 4);
+            const __m256i  b01 = _mm256_i32gather_epi32(p, _mm256_add_epi32(i, by1), 4);
+            const __m256i  b11 = _mm256_i32gather_epi32(p, _mm256_add_epi32(j, by1), 4);
+
+            const __m256 sx = sCurveAvx2(rx0);
+            const __m256 sy = sCurveAvx2(ry0);
+            const __m256 sz = sCurveAvx2(rz0);
+
+            const __m256 c = lerpAvx2(sy,
+                                      lerpAvx2(sx, dotAvx2(params, _mm256_add_epi32(b00, bz0), rx0, ry0, rz0), dotAvx2(params, _mm256_add_epi32(b10, bz0), rx1, ry0, rz0)),
+                                      lerpAvx2(sx, dotAvx2(params, _mm256_add_epi32(b01, bz0), rx0, ry1, rz0), dotAvx2(params, _mm256_add_epi32(b11, bz0), rx1, ry1, rz0)));
+            const __m256 d = lerpAvx2(sy,
+                                      lerpAvx2(sx, dotAvx2(params, _mm256_add_epi32(b00, bz1), rx0, ry0, rz1), dotAvx2(params, _mm256_add_epi32(b10, bz1), rx1, ry0, rz1)),
+                                      lerpAvx2(sx, dotAvx2(params, _mm256_add_epi32(b01, bz1), rx0, ry1, rz1), dotAvx2(params, _mm256_add_epi32(b11, bz1), rx1, ry1, rz1)));
+            return lerpAvx2(sz, c, d);
+        }
+
+        SIMD_TARGET("avx2")
+        void runAvx2(const NoiseParams& params, const float* x, const float* y, const float* z, uint32_t count, float* values)
+        {
+            const __m256 frequency = _mm256_set1_ps(params.frequency);
+            const __m256 two       = _mm256_set1_ps(2.0f);
+
+            auto i = 0u;
+            for (; i + 8u <= count; i += 8u)
+            {
+                __m256 px = _mm256_mul_ps(_mm256_loadu_ps(x + i), frequency);
+                __m256 py = _mm256_mul_ps(_mm256_loadu_ps(y + i), frequency);
+                __m256 pz = _mm256_mul_ps(_mm256_loadu_ps(z + i), frequency);
+
+                __m256 result    = _mm256_setzero_ps();
+                float  amplitude = params.amplitude;
+                for (auto o = 0u; o < params.octaves; ++o)
+                {
+                    result = _mm256_add_ps(result, _mm256_mul_ps(octaveAvx2(params, px, py, pz), _mm256_set1_ps(amplitude)));
+                    px     = _mm256_mul_ps(px, two);
+                    py     = _mm256_mul_ps(py, two);
+                    pz     = _mm256_mul_ps(pz, two);
+                    amplitude *= 0.5f;
+                }
+                _mm256_storeu_ps(values + i, result);
+            }
+            runScalar(params, x + i, y + i, z + i, count - i, values + i);
+        }
+#endif
+
+        // CLxPerlin's gradient component, a rand() value spread over [-1, 1).
+        inline float randomComponent()
+        {
+            const int32_t b = static_cast<int32_t>(GradientNoise::samples);
+            return static_cast<float>((std::rand() % (b + b)) - b) / b;
+        }
+    }  // namespace
+
+    GradientNoise::GradientNoise(uint32_t octaves, float frequency, float amplitude, int32_t seed)
+        : m_octaves(octaves), m_frequency(frequency), m_amplitude(amplitude)
+    {
+        // The tables have to come out of the C library's rand() in exactly CLxPerlin's order,
+        // including the 1d and 2d gradients it makes but this never uses.  rand() is one shared
+        // sequence, so at least keep two of these from interleaving theirs.
+        static std::mutex           randLock;
+        std::lock_guard<std::mutex> lock(randLock);
+        std::srand(static_cast<unsigned>(seed));
+
+        for (auto i = 0u; i < samples; ++i)
+        {
+            m_perm[i] = static_cast<int32_t>(i);
+
+            randomComponent();  // 1d gradient
+            randomComponent();  // 2d gradient
+            randomComponent();
+
+            const float x      = randomComponent();
+            const float y      = randomComponent();
+            const float z      = randomComponent();
+            const float length = std::sqrt(x * x + y * y + z * z);
+            const float scale  = 1.0f / length;
+            m_gradX[i]         = x * scale;
+            m_gradY[i]         = y * scale;
+            m_gradZ[i]         = z * scale;
+        }
+
+        for (auto i = samples - 1u; i > 0u; --i)
+            std::swap(m_perm[i], m_perm[static_cast<uint32_t>(std::rand()) % samples]);
+
+        for (auto i = 0u; i < samples + 2u; ++i)
+        {
+            m_perm[samples + i]  = m_perm[i];
+            m_gradX[samples + i] = m_gradX[i];
+            m_gradY[samples + i] = m_gradY[i];
+            m_gradZ[samples + i] = m_gradZ[i];
+        }
+    }
+
+    float GradientNoise::eval(float x, float y, float z) const
+    {
+        const NoiseParams params{ m_perm.data(), m_gradX.data(), m_gradY.data(), m_gradZ.data(), m_octaves, m_frequency, m_amplitude };
+        return evalScalar(params, x, y, z);
+    }
+
+    void GradientNoise::evalRun(const float* x, const float* y, const float* z, uint32_t count, float* values) const
+    {
+        const NoiseParams params{ m_perm.data(), m_gradX.data(), m_gradY.data(), m_gradZ.data(), m_octaves, m_frequency, m_amplitude };
+#ifdef SIMD_X86
+        if (m_isa == Isa::avx2)
+        {
+            runAvx2(params, x, y, z, count, values);
+            return;
+        }
+#endif
+        runScalar(params, x, y, z, count, values);
+    }
+
+    void GradientNoise::setIsa(Isa isa)
+    {
+        m_isa = isaSupported(isa) ? isa : bestIsa();
+    }
+
+    Isa GradientNoise::isa() const
+    {
+        return m_isa;
+    }
+}  // namespace partCore
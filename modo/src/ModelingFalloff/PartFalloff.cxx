@@ -4,9 +4,18 @@
 #include <lxsdk/lx_handles.hpp>
 #include <lxsdk/lx_layer.hpp>
 #include <lxsdk/lx_log.hpp>
+#include <lxsdk/lx_mesh.hpp>
 
+#include <util/Parallel.hxx>
+
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -33,71 +42,150 @@ namespace global
         static uint32_t  Steps      = 4u;
     }  // namespace drawing
 
-    namespace attrs
-    {
-        static std::string const mode{ "mode" };
-        static std::string const start{ "start" };
-        static std::string const startX{ "start.X" };
-        static std::string const startY{ "start.Y" };
-        static std::string const startZ{ "start.Z" };
-        static std::string const end{ "end" };
-        static std::string const endX{ "end.X" };
-        static std::string const endY{ "end.Y" };
-        static std::string const endZ{ "end.Z" };
-        static std::string const seed{ "seed" };
-        static std::string const scale{ "scale" };
-
-        static std::vector<std::pair<std::string, std::string>> typeMap{
-            { mode, LXsTYPE_INTEGER },    { startX, LXsTYPE_DISTANCE }, { startY, LXsTYPE_DISTANCE },
-            { startZ, LXsTYPE_DISTANCE }, { endX, LXsTYPE_DISTANCE },   { endY, LXsTYPE_DISTANCE },
-            { endZ, LXsTYPE_DISTANCE },   { scale, LXsTYPE_PERCENT },   { seed, LXsTYPE_INTEGER },
-        };
-    }  // namespace attrs
-
     LXtTextValueHint falloffModes[] = { { static_cast<uint32_t>(FalloffMode::Position), "Position" },
                                         { static_cast<uint32_t>(FalloffMode::Random), "Random" },
+                                        { static_cast<uint32_t>(FalloffMode::Radial), "Radial" },
+                                        { static_cast<uint32_t>(FalloffMode::Selection), "Selection" },
+                                        { static_cast<uint32_t>(FalloffMode::Statistic), "Statistic" },
+                                        { static_cast<uint32_t>(FalloffMode::AlignDirection), "AlignDirection" },
+                                        { static_cast<uint32_t>(FalloffMode::AlignView), "AlignView" },
                                         { -1, NULL } };
+
+    LXtTextValueHint partStatistics[] = { { static_cast<uint32_t>(PartStatistic::Area), "Area" },
+                                          { static_cast<uint32_t>(PartStatistic::Volume), "Volume" },
+                                          { static_cast<uint32_t>(PartStatistic::Vertices), "Vertices" },
+                                          { -1, NULL } };
+
+    // The modes that are placed with the start and end handles.
+    static bool usesHandles(FalloffMode mode)
+    {
+        return mode == FalloffMode::Position || mode == FalloffMode::Radial || mode == FalloffMode::Selection || mode == FalloffMode::AlignDirection;
+    }
+
     template <typename T>
-    static T evalFalloff(const component::PartMap& map, const ToolSettings& settings, component::Cache& cache, uint32_t part)
+    static T evalFalloff(const component::WeightTable& weights, const ToolSettings& settings, uint32_t part)
     {
-        T defaultWght{ 1.0 };
-        if (map.empty())
-            return defaultWght;
+        // Points added since the map was built don't belong to any part yet.
+        if (part >= weights.count())
+            return T{ 1.0 };
 
-        auto val = cache.get(part);
-        if (val)
-            return settings.scale * val.value();
+        return static_cast<T>(weights.weight(part) * settings.scale);
+    }
 
-        auto cacheAndReturn = [&](T w)
-        {
-            cache.set(part, w);
-            return w * settings.scale;
-        };
+    // The SDK accessors aren't thread safe, so the mesh is copied out on one thread and
+    // the islands are built from the copy over every core.  Selected polys pass their
+    // selection on to their points, so either selection mode picks out parts.
+    //
+    // Along the way it takes a fingerprint of the mesh, from the point ids, positions and
+    // selection, and the poly ids, selection and the ids of their points, so it changes
+    // whenever the islands or anything measured from them could.  Without an input only
+    // the fingerprint is taken, and nothing is allocated.
+    static uint64_t scanMesh(CLxUser_Mesh& mesh, partCore::MeshInput* input)
+    {
+        CLxUser_MeshService meshSvc;
+        CLxUser_Polygon     polys(mesh);
+        CLxUser_Point       points;
+        points.fromMesh(mesh);
 
-        CLxEaseFraction remap;
-        CLxPerlin<T>    noise(4, 1, 1, settings.seed);
-        CLxVector       v;
+        const auto selectMode = meshSvc.ModeCompose(LXsMARK_SELECT, nullptr);
 
-        auto* partData = map.get(part);
-        assert(partData);
+        const auto pointCount = static_cast<uint32_t>(mesh.NPoints());
+        auto       hash       = partCore::mixHash(pointCount);
+        if (input)
+        {
+            input->positions.resize(pointCount);
+            input->pointIds.resize(pointCount);
+            input->selected.resize(pointCount);
+        }
+        for (auto i = 0u; i < pointCount; ++i)
+        {
+            LXtFVector pos;
+            points.SelectByIndex(i);
+            points.Pos(pos);
+            const auto id       = reinterpret_cast<uintptr_t>(points.ID());
+            const auto selected = points.TestMarks(selectMode) == LXe_TRUE;
+            if (input)
+            {
+                input->positions[i] = { pos[0], pos[1], pos[2] };
+                input->pointIds[i]  = id;
+                input->selected[i]  = selected;
+            }
+
+            uint32_t bits[3];
+            std::memcpy(bits, pos, sizeof(bits));
+            hash = partCore::mixHash(hash ^ id);
+            hash = partCore::mixHash(hash ^ (static_cast<uint64_t>(bits[0]) << 32 | bits[1]));
+            hash = partCore::mixHash(hash ^ (static_cast<uint64_t>(bits[2]) << 1 | selected));
+        }
 
-        switch (settings.mode)
+        const auto polyCount = static_cast<uint32_t>(mesh.NPolygons());
+        hash                 = partCore::mixHash(hash ^ polyCount);
+        if (input)
+        {
+            input->polyOffsets.resize(polyCount + 1u);
+            input->polyPoints.reserve(polyCount * 4u);
+        }
+        for (auto i = 0u; i < polyCount; ++i)
         {
-            case global::FalloffMode::Random:
-                return cacheAndReturn(noise.eval(partData->center));
+            unsigned vertCount{};
+            polys.SelectByIndex(i);
+            polys.VertexCount(&vertCount);
+            const auto selected = polys.TestMarks(selectMode) == LXe_TRUE;
+            hash                = partCore::mixHash(hash ^ reinterpret_cast<uintptr_t>(polys.ID()));
+            hash                = partCore::mixHash(hash ^ (static_cast<uint64_t>(vertCount) << 1 | selected));
+            if (input)
+                input->polyOffsets[i] = static_cast<uint32_t>(input->polyPoints.size());
+
+            // Rewiring a poly keeps its id and size, so its points go in the hash too.
+            for (auto v = 0u; v < vertCount; ++v)
+            {
+                LXtPointID pointId;
+                polys.VertexByIndex(v, &pointId);
+                hash = partCore::mixHash(hash ^ reinterpret_cast<uintptr_t>(pointId));
+                if (!input)
+                    continue;
+
+                unsigned pointIndex{};
+                points.Select(pointId);
+                points.Index(&pointIndex);
+                input->polyPoints.push_back(pointIndex);
+                if (selected)
+                    input->selected[pointIndex] = 1u;
+            }
+        }
+        if (input)
+            input->polyOffsets[polyCount] = static_cast<uint32_t>(input->polyPoints.size());
 
-            case global::FalloffMode::Position:
-                v = settings.maxPos - settings.minPos;
-                remap.set_shape(LXiESHP_LINEAR);
+        return hash;
+    }
 
-                auto offsetVec = partData->center - settings.minPos;
-                auto num       = offsetVec.dot(v);
-                auto den       = v.lengthSquared();
-                if (den)
-                    return cacheAndReturn(remap.evaluate(num / den));
-        }
+    // The viewport a tool vector stack is for, from its view event packet, or zero if it
+    // doesn't have one.  Draws and screen space evaluations both get stacks carrying it, so
+    // it's what renders are kept under.
+    static uintptr_t viewportOf(ILxUnknownID vts, uint32_t viewOffset)
+    {
+        CLxUser_VectorStack vec(vts);
+        const auto*         event = vec.test() ? static_cast<const LXpToolViewEvent*>(vec.Read(viewOffset)) : nullptr;
+        return event ? reinterpret_cast<uintptr_t>(event->vport) : 0u;
+    }
 
-        return cacheAndReturn(defaultWght);
+    // What the mesh looks like from the outside, read without touching its points.  Any
+    // edit that changes it needs the islands found again, but the same signal doesn't
+    // mean the same mesh, so a match still needs the fingerprint checking.
+    static component::MeshSignal meshSignal(CLxUser_Mesh& mesh)
+    {
+        component::MeshSignal signal{};
+        signal.points = static_cast<uint32_t>(mesh.NPoints());
+        signal.polys  = static_cast<uint32_t>(mesh.NPolygons());
+
+        LXtBBox bounds{};
+        if (LXx_OK(mesh.BoundingBox(LXiMARK_ANY, &bounds)))
+            for (auto a = 0u; a < 3u; ++a)
+            {
+                signal.bounds[a]      = bounds.min[a];
+                signal.bounds[a + 3u] = bounds.max[a];
+            }
+        return signal;
     }
 
     struct DrawInfo
@@ -236,134 +324,394 @@ namespace com
 
 namespace component
 {
-    void Attributes::initAttrs(const AttributeTypeMap& attrList)
+    void Attributes::initAttrs()
+    {
+        for (const auto& attr : global::attrs::table)
+            dyna_Add(attr.name, attr.type);
+    }
+
+    std::vector<uint32_t> PartMap::updateFromInput(const partCore::MeshInput& input)
     {
-        uint32_t idx     = 0;
-        auto     addAttr = [&](const AttributeDefinition& attr)
+        std::vector<uint32_t> previous;
+        const auto            topology = partCore::topologyHash(input);
+        if (!empty() && topology == m_topology)
         {
-            dyna_Add(attr.first, attr.second);
-            m_attrMap[attr.first] = idx++;
-        };
+            // Same points and polys, so the islands and lookup still hold and only the
+            // islands whose points moved need measuring again.
+            const auto dirty = partCore::refreshIslands(m_islands, input);
+            previous.resize(m_islands.count());
+            for (auto i = 0u; i < previous.size(); ++i)
+                previous[i] = i;
+            for (auto part : dirty)
+                previous[part] = partCore::invalidIndex;
+
+            if (dirty.empty())
+                return previous;
+        }
+        else
+        {
+            // The islands are found again, and the ones the edit didn't touch are matched
+            // up with what they were by their signatures.
+            std::unordered_map<uint64_t, uint32_t> before;
+            before.reserve(m_islands.count());
+            for (auto i = 0u; i < m_islands.count(); ++i)
+                before.emplace(m_islands.signatures[i], i);
+
+            m_islands  = partCore::findIslands(input);
+            m_topology = topology;
+            m_lookup.build(input.pointIds, m_islands.pointIsland);
+
+            previous.assign(m_islands.count(), partCore::invalidIndex);
+            for (auto i = 0u; i < previous.size(); ++i)
+            {
+                const auto match = before.find(m_islands.signatures[i]);
+                if (match != before.end())
+                    previous[i] = match->second;
+            }
+        }
+
+        const auto count = m_islands.count();
+
+        std::vector<uint32_t> selected;
+        for (auto i = 0u; i < count; ++i)
+            if (m_islands.selected[i])
+                selected.push_back(i);
+        m_selection.build(m_islands.centers, selected);
+
+        CLxBoundingBox boundary{};
+        for (auto i = 0u; i < count; ++i)
+            boundary.add(center(i));
+        LXx_VCPY(m_min.v, boundary._min);
+        LXx_VCPY(m_max.v, boundary._max);
 
-        for (const auto& attr : attrList)
-            addAttr(attr);
+        return previous;
     }
 
-    uint32_t Attributes::index(const std::string& attr)
+    const std::pair<CLxVector, CLxVector> PartMap::bounds() const
     {
-        assert(m_attrMap.find(attr) != m_attrMap.end());
-        return m_attrMap.at(attr);
+        return std::make_pair(m_min, m_max);
     }
 
-    void Attributes::setHint(const std::string& attr, const LXtTextValueHint* hint)
+    bool PartMap::empty() const
     {
-        assert(m_attrMap.find(attr) != m_attrMap.end());
+        return m_islands.count() == 0u;
+    }
 
-        dyna_SetHint(m_attrMap.at(attr), hint);
+    uint32_t PartMap::partOf(LXtPointID point) const
+    {
+        return m_lookup.find(reinterpret_cast<uintptr_t>(point));
     }
 
-    template <class T>
-    T Attributes::getAttr(const std::string& attr)
+    void PartMap::partsOf(const LXtPointID* points, uint32_t count, uint32_t* parts) const
     {
-        assert(m_attrMap.find(attr) != m_attrMap.end());
+        m_lookup.findRun(points, count, parts);
+    }
 
-        T val{};
-        if constexpr (std::is_same_v<T, double>)
-            val = dyna_Float(m_attrMap.at(attr));
-        else if constexpr (std::is_same_v<T, int>)
-            val = dyna_Int(m_attrMap.at(attr));
+    const util::IdTable& PartMap::lookup() const
+    {
+        return m_lookup;
+    }
 
-        return val;
+    uint32_t PartMap::pointCount() const
+    {
+        return static_cast<uint32_t>(m_islands.points.size());
     }
 
-    template <>
-    std::string Attributes::getAttr<std::string>(const std::string& attr)
+    uint32_t PartMap::count() const
     {
-        assert(m_attrMap.find(attr) != m_attrMap.end());
+        return m_islands.count();
+    }
 
-        std::string val;
-        dyna_String(m_attrMap.at(attr), val);
-        return val;
+    CLxVector PartMap::center(uint32_t part) const
+    {
+        const auto& centers = m_islands.centers;
+        return CLxVector(centers.x[part], centers.y[part], centers.z[part]);
     }
 
-    template <>
-    CLxVector Attributes::getAttr<CLxVector>(const std::string& attr)
+    const partCore::Vec3Array& PartMap::centers() const
     {
-        assert(m_attrMap.find(attr) != m_attrMap.end());
+        return m_islands.centers;
+    }
 
-        CLxVector val;
-        uint32_t  start = m_attrMap.at(attr);
-        for (auto i = 0u; i < 3u; ++i)
-            val[i] = dyna_Float(start + i);
+    const partCore::Islands& PartMap::islands() const
+    {
+        return m_islands;
+    }
+
+    CLxVector PartMap::axis(uint32_t part) const
+    {
+        const auto& axes = m_islands.axes;
+        return CLxVector(axes.x[part], axes.y[part], axes.z[part]);
+    }
+
+    float PartMap::statistic(uint32_t part, global::PartStatistic stat) const
+    {
+        switch (stat)
+        {
+            case global::PartStatistic::Area:
+                return m_islands.area[part];
+            case global::PartStatistic::Volume:
+                return m_islands.volume[part];
+            case global::PartStatistic::Vertices:
+                return static_cast<float>(m_islands.pointCount(part));
+        }
+        return 0.0f;
+    }
 
-        return val;
+    const partCore::KdTree& PartMap::selection() const
+    {
+        return m_selection;
     }
 
-    void PartMap::buildFromMesh(CLxUser_Mesh& mesh)
+    PartMapCache& PartMapCache::instance()
     {
-        std::unordered_map<uint32_t, CLxPositionData> boxes;
+        static PartMapCache cache;
+        return cache;
+    }
 
-        CLxUser_Point pointAcc;
-        pointAcc.fromMesh(mesh);
+    PartMapCache::MapPtr PartMapCache::acquire(CLxUser_Mesh& mesh)
+    {
+        const auto meshId = reinterpret_cast<uintptr_t>(mesh.m_loc);
+        const auto signal = global::meshSignal(mesh);
 
-        const auto nPts = mesh.NPoints();
-        for (auto i = 0; i < nPts; ++i)
+        // Only a mesh that looks like a cached one is worth fingerprinting.  That still
+        // reads every point and poly, but into nothing.
+        auto known = false;
         {
-            pointAcc.SelectByIndex(i);
+            std::lock_guard<std::mutex> scopeLock(m_lock);
+            for (const auto& entry : m_entries)
+                known = known || (entry.mesh == meshId && entry.signal == signal);
+        }
+        if (known)
+        {
+            const auto                  fingerprint = global::scanMesh(mesh, nullptr);
+            std::lock_guard<std::mutex> scopeLock(m_lock);
+            for (auto entry = m_entries.begin(); entry != m_entries.end(); ++entry)
+                if (entry->mesh == meshId && entry->fingerprint == fingerprint)
+                {
+                    m_entries.splice(m_entries.begin(), m_entries, entry);
+                    return entry->map;
+                }
+        }
 
-            uint32_t part;
-            pointAcc.Part(&part);
+        // Built without the lock, so other meshes aren't held up.  If two falloffs race to
+        // build the same map, the second one in just uses the first's.
+        partCore::MeshInput input;
+        const auto          fingerprint = global::scanMesh(mesh, &input);
+        auto                map         = std::make_shared<PartMap>();
+        map->updateFromInput(input);
 
-            LXtFVector v;
-            pointAcc.Pos(v);
+        std::lock_guard<std::mutex> scopeLock(m_lock);
+        for (const auto& entry : m_entries)
+            if (entry.mesh == meshId && entry.fingerprint == fingerprint)
+                return entry.map;
+
+        m_entries.push_front({ meshId, signal, fingerprint, map });
+        m_points += map->pointCount();
+        trim();
+        return map;
+    }
 
-            CLxPositionData& data = boxes[part];
-            data.add(v);
+    void PartMapCache::trim()
+    {
+        // The newest entry always stays, however big it is.
+        while (m_entries.size() > 1u && (m_entries.size() > maxEntries || m_points > maxPoints))
+        {
+            m_points -= m_entries.back().map->pointCount();
+            m_entries.pop_back();
         }
+    }
 
-        CLxBoundingBox boundary{};
-        for (auto& [part, box] : boxes)
+    namespace
+    {
+        // What the modes share across every part, worked out once per build or update.  It's
+        // only read once made, so every chunk can use the one.
+        class PartWeights
         {
-            m_map.emplace(std::piecewise_construct, std::make_tuple(part), std::make_tuple(box.center(), box.axis()));
-            boundary.add(box.center());
-        }
-        LXx_VCPY(m_min.v, boundary._min);
-        LXx_VCPY(m_max.v, boundary._max);
+        public:
+            PartWeights(const PartMap& map, const global::ToolSettings& settings)
+                : m_map(map), m_settings(settings)
+            {
+                // The random mode has always been CLxPerlin(4, 1, 1, seed), which the noise
+                // reproduces.  Making it reseeds rand(), so only the random mode does.
+                if (settings.mode == global::FalloffMode::Random)
+                    m_noise.emplace(4u, 1.0f, 1.0f, settings.seed);
+
+                m_v     = settings.maxPos - settings.minPos;
+                m_den   = m_v.lengthSquared();
+                m_range = m_v.length();
+
+                // Position weights are dot(center - start, v / |v|^2).
+                for (auto a = 0u; a < 3u; ++a)
+                {
+                    m_origin[a] = static_cast<float>(settings.minPos[a]);
+                    m_along[a]  = m_den ? static_cast<float>(m_v[a] / m_den) : 0.0f;
+                }
+
+                // The alignment modes compare against a unit direction, or zero if there isn't one.
+                m_direction = settings.mode == global::FalloffMode::AlignView ? settings.viewVector : m_v;
+                if (m_direction.lengthSquared() > 0.0)
+                    m_direction.normalize();
+
+                // The statistic mode places each part between the smallest and largest.
+                const auto count = map.count();
+                if (settings.mode == global::FalloffMode::Statistic && count)
+                {
+                    m_statMin = m_statMax = map.statistic(0u, settings.statistic);
+                    for (auto i = 1u; i < count; ++i)
+                    {
+                        const auto stat = map.statistic(i, settings.statistic);
+                        m_statMin       = std::min(m_statMin, stat);
+                        m_statMax       = std::max(m_statMax, stat);
+                    }
+                }
+            }
+
+            // Weights of the parts [begin, end), written to weights[begin, end).
+            void run(uint32_t begin, uint32_t end, float* weights) const
+            {
+                const auto& centers   = m_map.centers();
+                const auto& selection = m_map.selection();
+
+                CLxEaseFraction remap;
+                remap.set_shape(LXiESHP_LINEAR);
+                auto ease = [&](double t) { return static_cast<float>(remap.evaluate(std::clamp(t, 0.0, 1.0))); };
+
+                switch (m_settings.mode)
+                {
+                    // The noise runs straight down the center arrays.
+                    case global::FalloffMode::Random:
+                        m_noise->evalRun(&centers.x[begin], &centers.y[begin], &centers.z[begin], end - begin, &weights[begin]);
+                        break;
+
+                    // The ease is linear, so a part's weight is just how far along the
+                    // start-end line its center sits, clamped to its ends.  That's one dot
+                    // product per part straight down the center arrays.
+                    case global::FalloffMode::Position:
+                        if (m_den)
+                            m_project(&centers.x[begin], &centers.y[begin], &centers.z[begin], end - begin, m_origin, m_along, &weights[begin]);
+                        else
+                            std::fill(weights + begin, weights + end, 1.0f);
+                        break;
+
+                    // Full weight at the start point, easing out to nothing at the end point.
+                    case global::FalloffMode::Radial:
+                        for (auto i = begin; i < end; ++i)
+                        {
+                            const auto dist = (m_map.center(i) - m_settings.minPos).length();
+                            weights[i]      = m_range ? ease(1.0 - dist / m_range) : 1.0f;
+                        }
+                        break;
+
+                    // Full weight on the selected parts, easing out to nothing a start-end
+                    // length away.  With nothing selected every part is affected, like the
+                    // rest of modo.
+                    case global::FalloffMode::Selection:
+                        for (auto i = begin; i < end; ++i)
+                        {
+                            float distSq{};
+                            if (selection.nearest(centers.get(i), distSq) == partCore::invalidIndex)
+                                weights[i] = 1.0f;
+                            else if (m_range)
+                                weights[i] = ease(1.0 - std::sqrt(distSq) / m_range);
+                            else
+                                weights[i] = distSq == 0.0f ? 1.0f : 0.0f;
+                        }
+                        break;
+
+                    case global::FalloffMode::Statistic:
+                        for (auto i = begin; i < end; ++i)
+                        {
+                            const auto stat = m_map.statistic(i, m_settings.statistic);
+                            weights[i]      = m_statMax > m_statMin ? ease((stat - m_statMin) / double(m_statMax - m_statMin)) : 1.0f;
+                        }
+                        break;
+
+                    // Full weight for parts lying along the direction, nothing for those across
+                    // it.  The axes have no sign, so either way along counts.
+                    case global::FalloffMode::AlignDirection:
+                    case global::FalloffMode::AlignView:
+                        for (auto i = begin; i < end; ++i)
+                            weights[i] = ease(std::abs(m_map.axis(i).dot(m_direction)));
+                        break;
+                }
+            }
+
+        private:
+            const PartMap&                         m_map;
+            const global::ToolSettings&            m_settings;
+            std::optional<partCore::GradientNoise> m_noise;
+            const partCore::ProjectKernel          m_project{ partCore::projectKernel(partCore::bestIsa()) };
+            float                                  m_origin[3]{};
+            float                                  m_along[3]{};
+            CLxVector                              m_v;
+            CLxVector                              m_direction;
+            double                                 m_den{};
+            double                                 m_range{};
+            float                                  m_statMin{};
+            float                                  m_statMax{};
+        };
+    }  // namespace
+
+    void WeightTable::build(const PartMap& map, const global::ToolSettings& settings)
+    {
+        const auto count = map.count();
+        m_weights.resize(count);
+
+        const PartWeights weights(map, settings);
+        parallel::forChunks(count, 1024u, [&](uint32_t, uint32_t begin, uint32_t end, uint32_t) { weights.run(begin, end, m_weights.data()); });
     }
 
-    const std::pair<CLxVector, CLxVector> PartMap::bounds() const
+    void WeightTable::update(const PartMap& map, const global::ToolSettings& settings, const std::vector<uint32_t>& previous)
     {
-        return std::make_pair(m_min, m_max);
+        // Selection and statistic weights depend on other parts, so any change can move them all.
+        const auto local = settings.mode == global::FalloffMode::Position || settings.mode == global::FalloffMode::Random ||
+                           settings.mode == global::FalloffMode::Radial || settings.mode == global::FalloffMode::AlignDirection ||
+                           settings.mode == global::FalloffMode::AlignView;
+        if (!local || m_weights.empty())
+        {
+            build(map, settings);
+            return;
+        }
+
+        std::vector<float>    kept(previous.size());
+        std::vector<uint32_t> dirty;
+        for (auto i = 0u; i < previous.size(); ++i)
+        {
+            if (previous[i] < m_weights.size())
+                kept[i] = m_weights[previous[i]];
+            else
+                dirty.push_back(i);
+        }
+        m_weights.swap(kept);
+
+        const PartWeights weights(map, settings);
+        parallel::forEach(static_cast<uint32_t>(dirty.size()), 256u, [&](uint32_t i) { weights.run(dirty[i], dirty[i] + 1u, m_weights.data()); });
     }
 
-    bool PartMap::empty() const
+    void WeightTable::clear()
     {
-        return m_map.empty();
+        m_weights.clear();
     }
 
-    const global::MeshPartData* PartMap::get(uint32_t part) const
+    uint32_t WeightTable::count() const
     {
-        auto it = m_map.find(part);
-        return it != m_map.end() ? &it->second : nullptr;
+        return static_cast<uint32_t>(m_weights.size());
     }
 
-    std::optional<double> Cache::get(uint32_t part)
+    float WeightTable::weight(uint32_t part) const
     {
-        std::scoped_lock<std::mutex> scopeLock(m_lock);
-        auto                         it = m_weights.find(part);
-        return it != m_weights.end() ? it->second : std::optional<double>{};
+        return m_weights[part];
     }
 
-    void Cache::set(uint32_t part, double weight)
+    const float* WeightTable::data() const
     {
-        std::scoped_lock<std::mutex> scopeLock(m_lock);
-        m_weights[part] = weight;
+        return m_weights.data();
     }
 
-    void Cache::clear()
+    void WeightTable::gather(const uint32_t* parts, uint32_t count, float scale, float* weights) const
     {
-        std::scoped_lock<std::mutex> scopeLock(m_lock);
-        m_weights.clear();
+        m_gather(m_weights.data(), this->count(), parts, count, scale, weights);
     }
 
 }  // namespace component
@@ -393,8 +741,12 @@ namespace partFalloff
         pktSvc.AddPacket(m_vType, LXsP_TOOL_ACTCENTER, LXfVT_GET);
         m_actionOffset = pktSvc.GetOffset(LXsCATEGORY_TOOL, LXsP_TOOL_ACTCENTER);
 
-        initAttrs(global::attrs::typeMap);
-        setHint(global::attrs::mode, global::falloffModes);
+        pktSvc.AddPacket(m_vType, LXsP_TOOL_VIEW_EVENT, LXfVT_GET);
+        m_viewOffset = pktSvc.GetOffset(LXsCATEGORY_TOOL, LXsP_TOOL_VIEW_EVENT);
+
+        initAttrs();
+        setHint<Id::mode>(global::falloffModes);
+        setHint<Id::statistic>(global::partStatistics);
     }
 
     LXtObjectID Tool::tool_VectorType()
@@ -416,24 +768,37 @@ namespace partFalloff
     {
         CLxUser_LayerService lsrv;
         CLxUser_LayerScan    scan;
-        CLxUser_Mesh         mesh;
 
-        lsrv.BeginScan(LXf_LAYERSCAN_PRIMARY, scan);
-        if (!scan.BaseMeshByIndex(0, mesh) || !mesh.test())
-            return;
+        lsrv.BeginScan(LXf_LAYERSCAN_ACTIVE, scan);
 
-        if (!m_primaryMesh.test() || !m_primaryMesh.IsSame(mesh))
+        std::vector<CLxUser_Mesh> meshes;
+        const auto                layerCount = scan.Count();
+        for (auto i = 0u; i < layerCount; ++i)
         {
-            m_falloffPkt = nullptr;
-            m_pktComPtr  = nullptr;
-            m_primaryMesh.set(mesh);
+            CLxUser_Mesh mesh;
+            if (scan.BaseMeshByIndex(i, mesh) && mesh.test())
+                meshes.push_back(mesh);
         }
 
+        if (meshes.empty())
+            return;
+
+        // New meshes are brought into the existing packet rather than starting over, so the
+        // parts the edit didn't touch keep their weights.
+        auto meshChanged = meshes.size() != m_meshes.size();
+        for (auto i = 0u; i < meshes.size() && !meshChanged; ++i)
+            meshChanged = !m_meshes[i].IsSame(meshes[i]);
+        if (meshChanged)
+            m_meshes.swap(meshes);
+
         if (!m_falloffPkt)
         {
             m_falloffPkt = com::spawn::packet(&m_pktComPtr);
-            m_falloffPkt->setupMesh(m_primaryMesh);
+            m_falloffPkt->setViewOffset(m_viewOffset);
+            m_falloffPkt->setupMeshes(m_meshes);
         }
+        else if (meshChanged)
+            m_falloffPkt->setupMeshes(m_meshes);
     }
 
     void Tool::tool_Evaluate(ILxUnknownID vts)
@@ -451,17 +816,42 @@ namespace partFalloff
         return LXfTMOD_DRAW_3D | LXfTMOD_I0_INPUT;
     }
 
-    void Tool::tmod_Draw(ILxUnknownID, ILxUnknownID stroke, int)
+    global::ToolSettings Tool::readSettings()
     {
-        if (getAttr<int>(global::attrs::mode) != static_cast<int>(global::FalloffMode::Position))
+        global::ToolSettings settings{};
+        settings.mode       = static_cast<global::FalloffMode>(getAttr<Id::mode>());
+        settings.statistic  = static_cast<global::PartStatistic>(getAttr<Id::statistic>());
+        settings.minPos     = getAttr<Id::startX>();
+        settings.maxPos     = getAttr<Id::endX>();
+        settings.viewVector = m_viewVector;
+        settings.seed       = getAttr<Id::seed>();
+        settings.scale      = getAttr<Id::scale>();
+        return settings;
+    }
+
+    void Tool::tmod_Draw(ILxUnknownID vts, ILxUnknownID stroke, int)
+    {
+        // The view isn't known when evaluating, so the eye direction at the middle of the
+        // parts is kept from here for the view alignment mode, and used from the next
+        // evaluation on.  Screen space tools likewise get the parts drawn for this view.
+        CLxUser_View eyeView(stroke);
+        if (eyeView.test() && m_falloffPkt)
+        {
+            const auto bounds = m_falloffPkt->partBounds();
+            CLxVector  middle = (bounds.first + bounds.second) / 2.0;
+            eyeView.EyeVector(middle.v, m_viewVector.v);
+            m_falloffPkt->updateScreen(vts, eyeView);
+        }
+
+        if (!global::usesHandles(static_cast<global::FalloffMode>(getAttr<Id::mode>())))
             return;
 
         CLxUser_HandleDraw draw(stroke);
 
-        auto start = getAttr<CLxVector>(global::attrs::startX);
+        auto start = getAttr<Id::startX>();
         draw.Handle(start.v, nullptr, global::id::startPt, 0);
 
-        auto end = getAttr<CLxVector>(global::attrs::endX);
+        auto end = getAttr<Id::endX>();
         draw.Handle(end.v, nullptr, global::id::endPt, 0);
 
         CLxUser_View view(stroke);
@@ -505,10 +895,10 @@ namespace partFalloff
         {
             m_isSetup = true;
             CLxUser_AdjustTool at(adjust);
-            at.SetFlt(index(global::attrs::scale), 1.0);
+            at.SetFlt(index<Id::scale>(), 1.0);
             auto& bounds = m_falloffPkt->partBounds();
-            setHandles(adjust, bounds.first, index(global::attrs::startX));
-            setHandles(adjust, bounds.second, index(global::attrs::endX));
+            setHandles(adjust, bounds.first, index<Id::startX>());
+            setHandles(adjust, bounds.second, index<Id::endX>());
         }
     }
 
@@ -525,22 +915,21 @@ namespace partFalloff
         {
             m_isSetup = true;
             m_inReset = true;
-            auto end  = getAttr<CLxVector>(global::attrs::endX);
+            auto end  = getAttr<Id::endX>();
             eventData.HitHandle(vts, end);
             inputData->part = global::id::endPt;
         }
         else if (inputData->part == global::id::startPt || inputData->part == global::id::endPt)
         {
-            auto& attr   = inputData->part == global::id::startPt ? global::attrs::startX : global::attrs::endX;
-            auto  hitPos = getAttr<CLxVector>(attr);
+            auto hitPos = inputData->part == global::id::startPt ? getAttr<Id::startX>() : getAttr<Id::endX>();
             eventData.HitHandle(vec, hitPos.v);
         }
         else
         {
             auto* acenData = static_cast<LXpToolActionCenter*>(vec.Read(m_actionOffset));
 
-            setHandles(adjust, acenData->v, index(global::attrs::startX));
-            setHandles(adjust, acenData->v, index(global::attrs::endX));
+            setHandles(adjust, acenData->v, index<Id::startX>());
+            setHandles(adjust, acenData->v, index<Id::endX>());
             eventData.HitHandle(vts, acenData->v);
             inputData->part = global::id::endPt;
             m_inReset       = true;
@@ -560,7 +949,7 @@ namespace partFalloff
 
             CLxVector dragPos;
             eventData.GetNewPosition(vec, dragPos);
-            uint32_t firstIdx = inputData->part == global::id::startPt ? index(global::attrs::startX) : index(global::attrs::endX);
+            uint32_t firstIdx = inputData->part == global::id::startPt ? index<Id::startX>() : index<Id::endX>();
             for (auto i = 0u; i < 3; ++i)
                 at.SetFlt(firstIdx + i, dragPos[i]);
         }
@@ -575,71 +964,226 @@ namespace partFalloff
         { LXsSRV_USERNAME, "tool.part.falloff" },
     };
 
-    void Packet::setupMesh(CLxUser_Mesh& mesh)
+    void Packet::setupMeshes(std::vector<CLxUser_Mesh>& meshes)
     {
-        m_pointAcc.fromMesh(mesh);
-        m_partData.buildFromMesh(mesh);
+        // The meshes are copied out one at a time, as the SDK needs, then every layer's
+        // parts and weights are brought up to date at once.  A layer with a lot of parts
+        // still goes wide on its own if it's the only one.
+        const auto                       layerCount = static_cast<uint32_t>(meshes.size());
+        std::vector<partCore::MeshInput> inputs(layerCount);
+        for (auto i = 0u; i < layerCount; ++i)
+            global::scanMesh(meshes[i], &inputs[i]);
+
+        m_layers.resize(layerCount);
+        parallel::forEach(layerCount,
+                          1u,
+                          [&](uint32_t i)
+                          {
+                              auto&      layer    = m_layers[i];
+                              const auto previous = layer.partData.updateFromInput(inputs[i]);
+
+                              // Before the first update there are no weights to keep, that
+                              // update builds them.
+                              if (layer.weights.count())
+                                  layer.weights.update(layer.partData, m_settings, previous);
+                          });
+
+        std::vector<uintptr_t> ids;
+        std::vector<uint32_t>  layers;
+        if (layerCount > 1u)
+            for (auto i = 0u; i < layerCount; ++i)
+            {
+                ids.insert(ids.end(), inputs[i].pointIds.begin(), inputs[i].pointIds.end());
+                layers.resize(ids.size(), i);
+            }
+        m_tables.setRouting(ids, layers);
+
+        for (auto i = 0u; i < layerCount; ++i)
+            m_layers[i].mesh = std::move(inputs[i]);
+        updateTables();
+
+        // The parts moved under the old renders, so the next draw of each view makes a new one.
+        m_tables.clearScreens();
     }
 
     const std::pair<CLxVector, CLxVector> Packet::partBounds() const
     {
-        return m_partData.bounds();
+        CLxBoundingBox boundary{};
+        auto           empty = true;
+        for (const auto& layer : m_layers)
+        {
+            if (layer.partData.empty())
+                continue;
+
+            const auto bounds = layer.partData.bounds();
+            boundary.add(bounds.first);
+            boundary.add(bounds.second);
+            empty = false;
+        }
+
+        if (empty)
+            return std::make_pair(CLxVector(), CLxVector());
+
+        CLxVector min;
+        CLxVector max;
+        LXx_VCPY(min.v, boundary._min);
+        LXx_VCPY(max.v, boundary._max);
+        return std::make_pair(min, max);
+    }
+
+    void Packet::setViewOffset(uint32_t offset)
+    {
+        m_viewOffset = offset;
+    }
+
+    void Packet::updateScreen(ILxUnknownID vts, CLxUser_View& view)
+    {
+        int width  = 0;
+        int height = 0;
+        if (view.Dimensions(&width, &height) != LXe_OK || width <= 0 || height <= 0)
+            return;
+
+        // The eye direction at the middle of the parts gives the depth.  Along any one
+        // pixel's ray it grows away from the eye, which is all the depth test needs.
+        const auto bounds = partBounds();
+        CLxVector  middle = (bounds.first + bounds.second) / 2.0;
+        CLxVector  eye;
+        view.EyeVector(middle.v, eye.v);
+
+        auto toScreen = [&](const double* pos, partCore::Vec3& screen)
+        {
+            double x = 0.0;
+            double y = 0.0;
+            if (view.ToScreen(pos, &x, &y) != LXe_OK)
+            {
+                screen.fill(std::numeric_limits<float>::quiet_NaN());
+                return;
+            }
+
+            screen = { static_cast<float>(x), static_cast<float>(y), static_cast<float>(LXx_VDOT(pos, eye.v)) };
+        };
+
+        // Any change to the view moves where the corners of the parts' bounds land, so
+        // those and the view size stand in for the view itself.
+        auto key = partCore::mixHash((static_cast<uint64_t>(width) << 32u) ^ static_cast<uint64_t>(height));
+        for (auto corner = 0u; corner < 8u; ++corner)
+        {
+            CLxVector pos(corner & 1u ? bounds.second[0] : bounds.first[0],
+                          corner & 2u ? bounds.second[1] : bounds.first[1],
+                          corner & 4u ? bounds.second[2] : bounds.first[2]);
+            partCore::Vec3 screen;
+            toScreen(pos.v, screen);
+            for (auto i = 0u; i < 3u; ++i)
+            {
+                uint32_t bits = 0u;
+                std::memcpy(&bits, &screen[i], sizeof(bits));
+                key = partCore::mixHash(key ^ bits);
+            }
+        }
+
+        auto* target = m_tables.draw(global::viewportOf(vts, m_viewOffset), key);
+        if (!target)
+            return;
+
+        // The view is only asked on this thread, then the triangles are drawn over every
+        // core.
+        std::vector<partCore::ScreenTriangle> triangles;
+        std::vector<partCore::Vec3>           screen;
+        target->starts.assign(m_layers.size(), 0u);
+        auto nextId = 0u;
+        for (auto i = 0u; i < m_layers.size(); ++i)
+        {
+            const auto& layer = m_layers[i];
+            screen.resize(layer.mesh.positions.size());
+            for (auto p = 0u; p < screen.size(); ++p)
+            {
+                const auto& pos = layer.mesh.positions[p];
+                const double point[3]{ pos[0], pos[1], pos[2] };
+                toScreen(point, screen[p]);
+            }
+
+            partCore::appendIslandTriangles(layer.partData.islands(), layer.mesh, screen, nextId, triangles);
+            target->starts[i] = nextId;
+            nextId += layer.partData.count();
+        }
+
+        target->ids.render(static_cast<uint32_t>(width), static_cast<uint32_t>(height), triangles);
     }
 
     // Populates or updates the tool settings struct
     void Packet::update(Tool& tool)
     {
-        global::ToolSettings tmpSettings{};
+        // A scale change, or a change to something the mode doesn't use, leaves the weights
+        // alone.  Anything else rebuilds them, which for the position mode is a single
+        // vectorized pass over the part centers.
+        const auto tmpSettings = tool.readSettings();
+        const auto changed     = m_settings != tmpSettings;
+        parallel::forEach(static_cast<uint32_t>(m_layers.size()),
+                          1u,
+                          [&](uint32_t i)
+                          {
+                              auto& layer = m_layers[i];
+                              if (changed || layer.weights.count() != layer.partData.count())
+                                  layer.weights.build(layer.partData, tmpSettings);
+                          });
 
-        tmpSettings.minPos = tool.getAttr<CLxVector>(global::attrs::startX);
-        tmpSettings.maxPos = tool.getAttr<CLxVector>(global::attrs::endX);
-        tmpSettings.mode   = static_cast<global::FalloffMode>(tool.getAttr<int>(global::attrs::mode));
-        tmpSettings.scale  = tool.getAttr<double>(global::attrs::scale);
-        tmpSettings.seed   = tool.getAttr<int>(global::attrs::seed);
+        m_settings = tmpSettings;
 
-        if (m_settings != tmpSettings)
-            m_weightCache.clear();
+        updateTables();
+        m_tables.publishScreens();
+    }
 
-        m_settings = tmpSettings;
+    void Packet::updateTables()
+    {
+        std::vector<partCore::FalloffTables::Layer> layers;
+        for (const auto& layer : m_layers)
+            layers.push_back({ &layer.partData.lookup(), layer.weights.data(), layer.weights.count() });
+        m_tables.setLayers(std::move(layers));
+        m_tables.setScale(m_settings.scale);
     }
 
     double Packet::fp_Evaluate(LXtFVector, LXtPointID vrx, LXtPolygonID)
     {
-        if (!vrx || !m_pointAcc.test() || m_partData.empty())
-            return 1.0;
-
-        uint32_t part;
-        m_pointAcc.Select(vrx);
-        m_pointAcc.Part(&part);
+        return m_tables.weightOf(reinterpret_cast<uintptr_t>(vrx));
+    }
 
-        return global::evalFalloff<double>(m_partData, m_settings, m_weightCache, part);
+    double Packet::fp_Screen(LXtObjectID vts, int x, int y)
+    {
+        // The screen tool's stack names its viewport the same way the draw's did.
+        return m_tables.weightAt(global::viewportOf(static_cast<ILxUnknownID>(vts), m_viewOffset), x, y);
     }
 
 }  // namespace partFalloff
 
 namespace falloffItem
 {
+    using global::attrs::Id;
+
     LxResult Package::pkg_SetupChannels(ILxUnknownID addChan)
     {
         CLxUser_AddChannel ac(addChan);
 
-        ac.NewChannel(global::attrs::mode.c_str(), LXsTYPE_INTEGER);
+        ac.NewChannel(global::attrs::name(Id::mode), LXsTYPE_INTEGER);
         ac.SetDefault(0.0, 0);
         ac.SetHint(global::falloffModes);
 
-        ac.NewChannel(global::attrs::start.c_str(), LXsTYPE_DISTANCE);
+        ac.NewChannel(global::attrs::start, LXsTYPE_DISTANCE);
         ac.SetVector(LXsCHANVEC_XYZ);
 
         CLxVector endDefault(0.0, 1.0, 0.0);
-        ac.NewChannel(global::attrs::end.c_str(), LXsTYPE_DISTANCE);
+        ac.NewChannel(global::attrs::end, LXsTYPE_DISTANCE);
         ac.SetVector(LXsCHANVEC_XYZ);
         ac.SetDefaultVec(endDefault);
 
-        ac.NewChannel(global::attrs::seed.c_str(), LXsTYPE_INTEGER);
+        ac.NewChannel(global::attrs::name(Id::seed), LXsTYPE_INTEGER);
         ac.SetDefault(0.0, 1701);
 
-        ac.NewChannel(global::attrs::scale.c_str(), LXsTYPE_PERCENT);
+        ac.NewChannel(global::attrs::name(Id::scale), LXsTYPE_PERCENT);
         ac.SetDefault(1.0, 0);
+
+        ac.NewChannel(global::attrs::name(Id::statistic), LXsTYPE_INTEGER);
+        ac.SetDefault(0.0, 0);
+        ac.SetHint(global::partStatistics);
         return LXe_OK;
     }
 
@@ -680,8 +1224,8 @@ namespace falloffItem
 
         global::DrawInfo info;
 
-        readVec(info.startPos, m_item.ChannelIndex(global::attrs::startX.c_str()));
-        readVec(info.endPos, m_item.ChannelIndex(global::attrs::endX.c_str()));
+        readVec(info.startPos, m_item.ChannelIndex(global::attrs::name(Id::startX)));
+        readVec(info.endPos, m_item.ChannelIndex(global::attrs::name(Id::endX)));
         info.height3D = 0.25;
         info.eyeVector.set(1.0, 0.0, 0.0);
         LXx_VCPY(info.color, color);
@@ -696,22 +1240,32 @@ namespace falloffItem
 
     float Falloff::fall_WeightF(const LXtFVector position, LXtPointID vrx, LXtPolygonID polygon)
     {
-        if (!vrx || !m_pointAcc.test() || m_partData.empty())
-            return 1.0;
+        if (!m_partData)
+            return 1.0f;
 
-        uint32_t part{};
-        m_lock.lock();
-        m_pointAcc.Select(vrx);
-        m_pointAcc.Part(&part);
-        m_lock.unlock();
-
-        return global::evalFalloff<float>(m_partData, settings, m_weightCache, part);
+        return global::evalFalloff<float>(m_weights, settings, m_partData->partOf(vrx));
     }
 
     LxResult Falloff::fall_WeightRun(const float** pos, const LXtPointID* points, const LXtPolygonID* polygons, float* weight, unsigned num)
     {
-        for (auto i = 0u; i < num; ++i)
-            weight[i] = fall_WeightF(pos[i], points[i], polygons ? polygons[0] : nullptr);
+        // The run is resolved to parts straight from the point ids, a block at a time on the
+        // stack, and the weights gathered in one go.  Nothing is locked or allocated.
+        constexpr uint32_t blockSize = 256u;
+
+        if (!m_partData)
+        {
+            std::fill(weight, weight + num, 1.0f);
+            return LXe_OK;
+        }
+
+        uint32_t   parts[blockSize];
+        const auto scale = static_cast<float>(settings.scale);
+        for (auto first = 0u; first < num; first += blockSize)
+        {
+            const auto count = std::min(num - first, blockSize);
+            m_partData->partsOf(points + first, count, parts);
+            m_weights.gather(parts, count, scale, weight + first);
+        }
 
         return LXe_OK;
     }
@@ -722,8 +1276,12 @@ namespace falloffItem
         CLxUser_Mesh                mesh(meshObj);
         if (!mesh.test())
             return LXe_FAILED;
-        m_partData.buildFromMesh(mesh);
-        m_pointAcc.fromMesh(mesh);
+
+        // The modifier sets the settings before the mesh arrives, so the weights can all
+        // be worked out now.  The parts come from the cache, so a falloff spawned for a
+        // settings change only works out weights, and never finds the islands again.
+        m_partData = component::PartMapCache::instance().acquire(mesh);
+        m_weights.build(*m_partData, settings);
 
         return LXe_OK;
     }
@@ -744,8 +1302,8 @@ namespace falloffItem
 
         eval.AddChan(item, LXsICHAN_XFRMCORE_WORLDMATRIX);
 
-        for (auto const& [name, type] : global::attrs::typeMap)
-            eval.AddChan(item, name.c_str());
+        for (const auto& attr : global::attrs::table)
+            eval.AddChan(item, attr.name);
     }
 
     void Modifier::Alloc(CLxUser_Evaluation&, CLxUser_Attributes& attr, unsigned firstIdx, ILxUnknownID& obj)
@@ -772,8 +1330,13 @@ namespace falloffItem
         falloff->settings.minPos += mat.getTranslation();
         falloff->settings.maxPos = mat * readVec();
         falloff->settings.maxPos += mat.getTranslation();
-        falloff->settings.scale = attr.Float(idx++);
-        falloff->settings.seed  = attr.Int(idx++);
+        falloff->settings.scale     = attr.Float(idx++);
+        falloff->settings.seed      = attr.Int(idx++);
+        falloff->settings.statistic = static_cast<global::PartStatistic>(attr.Int(idx++));
+
+        // There's no view for an item, so the view alignment mode uses the item's own Z axis
+        // instead, which can be aimed by rotating the item.
+        falloff->settings.viewVector = mat * CLxVector(0.0, 0.0, 1.0);
     }
 
 }  // namespace falloffItem
@@ -17,40 +17,87 @@
 #include <lxsdk/lxu_modifier.hpp>
 #include <lxsdk/lxu_vector.hpp>
 
+#include "FalloffTables.hxx"
+#include "IdBuffer.hxx"
+#include "Islands.hxx"
+#include "KdTree.hxx"
+#include "Kernels.hxx"
+#include "Noise.hxx"
+
+#include <util/IdTable.hxx>
+
+#include <algorithm>
+#include <array>
+#include <list>
+#include <memory>
 #include <mutex>
-#include <optional>
-#include <string>
-#include <type_traits>
-#include <unordered_map>
 
 // The part falloff is a tool that applies the same falloff percentage to all polys/edges/verts
 // that are part of the same mesh island.
 namespace global
 {
-    // Weight values are assigned to parts in one of 2 ways:
+    // Weight values are assigned to parts in one of 7 ways:
     //  - Part position, similar usage to the linear falloff tool
     //  - Randomly
+    //  - Distance of the part from the start point, out to the end point
+    //  - Distance of the part from the nearest selected part, out to the start-end length
+    //  - A measure of the part itself, relative to the smallest and largest parts
+    //  - How closely the part's main axis lines up with the start-end direction
+    //  - How closely the part's main axis lines up with the view
     enum class FalloffMode : uint32_t
     {
         Position,
-        Random
+        Random,
+        Radial,
+        Selection,
+        Statistic,
+        AlignDirection,
+        AlignView
+    };
+
+    enum class PartStatistic : uint32_t
+    {
+        Area,
+        Volume,
+        Vertices
     };
 
     extern LXtTextValueHint falloffModes[];
+    extern LXtTextValueHint partStatistics[];
 
     struct ToolSettings
     {
-        global::FalloffMode mode;
-        CLxVector           minPos;
-        CLxVector           maxPos;
-        CLxVector           viewVector;
-        int                 seed;
-        double              scale;
+        global::FalloffMode   mode;
+        global::PartStatistic statistic;
+        CLxVector             minPos;
+        CLxVector             maxPos;
+        CLxVector             viewVector;
+        int                   seed;
+        double                scale;
 
         bool operator==(const ToolSettings& other) const
         {
             // Deliberatly ignore scale, we just always apply that on top of cached values.
-            return (seed == other.seed && mode == other.mode && minPos == other.minPos && maxPos == other.maxPos && viewVector == other.viewVector);
+            // Anything else the mode doesn't use is ignored too, so dragging the handles
+            // doesn't rebuild random weights, or turning the view the positional ones.
+            if (mode != other.mode)
+                return false;
+
+            switch (mode)
+            {
+                case FalloffMode::Position:
+                case FalloffMode::Radial:
+                case FalloffMode::Selection:
+                case FalloffMode::AlignDirection:
+                    return minPos == other.minPos && maxPos == other.maxPos;
+                case FalloffMode::Random:
+                    return seed == other.seed;
+                case FalloffMode::Statistic:
+                    return statistic == other.statistic;
+                case FalloffMode::AlignView:
+                    return viewVector == other.viewVector;
+            }
+            return false;
         }
 
         bool operator!=(const ToolSettings& other) const
@@ -59,71 +106,248 @@ namespace global
         }
     };
 
-    struct MeshPartData
+    // The tool's attributes, in the order they're added, so an attribute's index is just its
+    // id.  The falloff item has a channel of the same name for each, which the modifier
+    // reads back in the same order.
+    namespace attrs
     {
-        MeshPartData(CLxVector& c, CLxVector& v) : center(c), vector(v)
+        enum class Id : uint32_t
+        {
+            mode,
+            startX,
+            startY,
+            startZ,
+            endX,
+            endY,
+            endZ,
+            scale,
+            seed,
+            statistic,
+            count
+        };
+
+        // How an attribute is read.  A vector is its own entry and the two after it.
+        enum class Kind : uint32_t
+        {
+            Int,
+            Float,
+            Vector
+        };
+
+        struct Definition
+        {
+            Id          id;
+            const char* name;
+            const char* type;
+            Kind        kind;
+        };
+
+        static constexpr std::array<Definition, static_cast<size_t>(Id::count)> table{ {
+            { Id::mode, "mode", LXsTYPE_INTEGER, Kind::Int },
+            { Id::startX, "start.X", LXsTYPE_DISTANCE, Kind::Vector },
+            { Id::startY, "start.Y", LXsTYPE_DISTANCE, Kind::Float },
+            { Id::startZ, "start.Z", LXsTYPE_DISTANCE, Kind::Float },
+            { Id::endX, "end.X", LXsTYPE_DISTANCE, Kind::Vector },
+            { Id::endY, "end.Y", LXsTYPE_DISTANCE, Kind::Float },
+            { Id::endZ, "end.Z", LXsTYPE_DISTANCE, Kind::Float },
+            { Id::scale, "scale", LXsTYPE_PERCENT, Kind::Float },
+            { Id::seed, "seed", LXsTYPE_INTEGER, Kind::Int },
+            { Id::statistic, "statistic", LXsTYPE_INTEGER, Kind::Int },
+        } };
+
+        // The item's vector channels, which the start.X etc. channels make up.
+        static constexpr const char* start = "start";
+        static constexpr const char* end   = "end";
+
+        constexpr const char* name(Id id)
         {
+            return table[static_cast<size_t>(id)].name;
         }
 
-        CLxVector center{ 0.0, 0.0, 0.0 };
-        CLxVector vector{ 0.0, 0.0, 0.0 };
-    };
+        // Every entry sits at its id, and every vector is followed by its other two parts.
+        constexpr bool tableIsValid()
+        {
+            for (auto i = 0u; i < table.size(); ++i)
+            {
+                if (static_cast<uint32_t>(table[i].id) != i)
+                    return false;
+                if (table[i].kind == Kind::Vector && (i + 2u >= table.size() || table[i + 1u].kind != Kind::Float || table[i + 2u].kind != Kind::Float))
+                    return false;
+            }
+            return true;
+        }
+
+        static_assert(tableIsValid(), "global::attrs::table is out of step with global::attrs::Id");
+    }  // namespace attrs
 }  // namespace global
 
 namespace component
 {
-    // Attributes are the tool's properties.
+    // Attributes are the tool's properties, as laid out in global::attrs::table.  Indices come
+    // straight from the ids at compile time, and the type read comes from the table, so
+    // nothing hashes or builds a string.
     class Attributes : public CLxDynamicAttributes
     {
     public:
-        using AttributeDefinition = std::pair<std::string, std::string>;
-        using AttributeTypeMap    = std::vector<std::pair<std::string, std::string>>;
-        using AttributeOffsetMap  = std::unordered_map<std::string, uint32_t>;
+        using Id = global::attrs::Id;
 
-        void initAttrs(const AttributeTypeMap& attrList);
+        void initAttrs();
 
-        void     setHint(const std::string& attr, const LXtTextValueHint* hint);
-        uint32_t index(const std::string& attr);
+        template <Id id>
+        static constexpr uint32_t index()
+        {
+            return static_cast<uint32_t>(id);
+        }
 
-        template <typename T>
-        T getAttr(const std::string& attr);
-        template <>
-        std::string getAttr<std::string>(const std::string& attr);
-        template <>
-        CLxVector getAttr<CLxVector>(const std::string& attr);
+        template <Id id>
+        void setHint(const LXtTextValueHint* hint)
+        {
+            dyna_SetHint(index<id>(), hint);
+        }
 
-    private:
-        AttributeOffsetMap   m_attrMap;
-        CLxUser_ValueService m_valSvc;
+        // An int, double or CLxVector, going by the attribute's kind.
+        template <Id id>
+        auto getAttr()
+        {
+            constexpr auto kind = global::attrs::table[index<id>()].kind;
+            if constexpr (kind == global::attrs::Kind::Int)
+                return dyna_Int(index<id>());
+            else if constexpr (kind == global::attrs::Kind::Float)
+                return dyna_Float(index<id>());
+            else
+            {
+                CLxVector val;
+                for (auto i = 0u; i < 3u; ++i)
+                    val[i] = dyna_Float(index<id>() + i);
+                return val;
+            }
+        }
     };
 
+    // Parts are the mesh islands found from the poly connectivity, rather than the mesh's
+    // own part tags, which can be stale.
     class PartMap
     {
     public:
-        void buildFromMesh(CLxUser_Mesh& mesh);
+        // Brings the map up to date with a copy of the mesh.  If only positions or selection
+        // changed, just the islands that moved are measured again, otherwise the islands
+        // are found from scratch.  Either way it returns, for every part, the part it was
+        // before if nothing about it changed, or partCore::invalidIndex, so untouched parts
+        // can keep their weights.  This doesn't touch the SDK, so the maps of several meshes
+        // can be brought up to date at once.
+        std::vector<uint32_t> updateFromInput(const partCore::MeshInput& input);
 
         bool empty() const;
 
         const std::pair<CLxVector, CLxVector> bounds() const;
 
-        const global::MeshPartData* get(uint32_t part) const;
+        // Part of the point, or partCore::invalidIndex for points the map hasn't seen.  Goes
+        // through the map's own lookup rather than an accessor, so it's safe from any thread.
+        uint32_t partOf(LXtPointID point) const;
+
+        // Parts for a run of point ids, without going through an accessor.
+        void partsOf(const LXtPointID* points, uint32_t count, uint32_t* parts) const;
+
+        // The lookup behind partOf, for the packet's tables.
+        const util::IdTable& lookup() const;
+
+        uint32_t pointCount() const;
+
+        // Parts are numbered densely from zero, so their data is indexed directly.
+        uint32_t  count() const;
+        CLxVector center(uint32_t part) const;
+        CLxVector axis(uint32_t part) const;  // Unit main axis, see partCore::Islands::axes
+        float     statistic(uint32_t part, global::PartStatistic stat) const;
+
+        const partCore::Vec3Array& centers() const;
+        const partCore::Islands&   islands() const;
+
+        // Tree over the centers of the parts that were selected when the map was built.
+        const partCore::KdTree& selection() const;
 
     private:
-        std::unordered_map<uint32_t, global::MeshPartData> m_map;
-        CLxVector                                          m_min;
-        CLxVector                                          m_max;
+        partCore::Islands     m_islands;
+        util::IdTable         m_lookup;
+        partCore::KdTree      m_selection;
+        CLxVector             m_min;
+        CLxVector             m_max;
+        uint64_t              m_topology{};
     };
 
-    class Cache
+    // Mesh counts and bounds, cheap enough to read on every lookup.
+    struct MeshSignal
+    {
+        uint32_t points;
+        uint32_t polys;
+        double   bounds[6];  // Min then max
+
+        bool operator==(const MeshSignal& other) const
+        {
+            return points == other.points && polys == other.polys && std::equal(bounds, bounds + 6, other.bounds);
+        }
+    };
+
+    // Process wide cache of built part maps, for the falloff items.  Modo spawns a new
+    // falloff for every channel change, so without it every nudge of a handle would find
+    // the islands all over again.  Maps are keyed on the mesh and a fingerprint of its
+    // contents, which is only taken when the mesh's signal matches a cached one.  They're
+    // handed out shared and immutable, so any number of falloffs can use one.  The least
+    // recently used are dropped once the total points go over budget.
+    class PartMapCache
+    {
+    public:
+        using MapPtr = std::shared_ptr<const PartMap>;
+
+        static PartMapCache& instance();
+
+        // Map for the mesh as it is now, built if the cache doesn't have it.
+        MapPtr acquire(CLxUser_Mesh& mesh);
+
+    private:
+        struct Entry
+        {
+            uintptr_t  mesh;
+            MeshSignal signal;
+            uint64_t   fingerprint;
+            MapPtr     map;
+        };
+
+        static constexpr size_t   maxEntries = 32u;
+        static constexpr uint64_t maxPoints  = 16u * 1024u * 1024u;
+
+        void trim();
+
+        std::list<Entry> m_entries;  // Most recently used first
+        uint64_t         m_points{};
+        std::mutex       m_lock;
+    };
+
+    // The weight of every part, filled in up front whenever the settings or mesh change.
+    // Nothing writes to it between builds, so any number of threads can read it without
+    // locking.  The weights are stored before the scale, which is applied on lookup.
+    class WeightTable
     {
     public:
-        std::optional<double> get(uint32_t part);
-        void                  set(uint32_t part, double weight);
-        void                  clear();
+        // Computes every part's weight for the settings over every core.
+        void build(const PartMap& map, const global::ToolSettings& settings);
+        void clear();
+
+        // Catches up with a map update, given what PartMap::updateFromInput returned.  Parts
+        // that didn't change keep their weights and only the rest are worked out, unless
+        // the mode weighs parts against each other, in which case they're all built again.
+        // The settings must be the ones the weights were built with.
+        void update(const PartMap& map, const global::ToolSettings& settings, const std::vector<uint32_t>& previous);
+
+        uint32_t     count() const;
+        float        weight(uint32_t part) const;
+        const float* data() const;
+
+        // Scaled weights for a run of parts in one go, see partCore::GatherKernel.
+        void gather(const uint32_t* parts, uint32_t count, float scale, float* weights) const;
 
     private:
-        std::unordered_map<uint32_t, double> m_weights;
-        std::mutex                           m_lock;
+        std::vector<float>     m_weights;
+        partCore::GatherKernel m_gather{ partCore::gatherKernel(partCore::bestIsa()) };
     };
 }  // namespace component
 
@@ -153,8 +377,11 @@ namespace partFalloff
 
         static LXtTagInfoDesc descInfo[];
 
+        // The settings as they stand.  Runs on every evaluation.
+        global::ToolSettings readSettings();
+
     private:
-        CLxUser_Mesh m_primaryMesh;
+        std::vector<CLxUser_Mesh> m_meshes;  // Every active layer's mesh, in scan order
 
         void validatePkt();
         void setHandles(ILxUnknownID adjust, const CLxVector& pos, uint32_t firstIdx);
@@ -162,32 +389,67 @@ namespace partFalloff
         bool m_isSetup{};
         bool m_inReset{};
 
+        CLxVector m_viewVector{ 0.0, 0.0, 1.0 };  // Eye direction of the view last drawn in
+
         CLxUser_VectorType m_vType;
         uint32_t           m_pktOffset{};
         uint32_t           m_handlesOffset{};
         uint32_t           m_inputOffset{};
         uint32_t           m_actionOffset{};
+        uint32_t           m_viewOffset{};
 
         Packet* m_falloffPkt{};
         void*   m_pktComPtr{};
     };
 
+    // Every active layer gets its own parts and weights.  Point ids are unique across
+    // meshes, so one lookup over all of them says which layer a point belongs to.
+    //
+    // Deformer stacks call the packet from many threads at once, so only setupMeshes and
+    // update write what the evaluation reads, and the tool never calls those while the
+    // packet is out.  Evaluating only reads the flat tables in m_tables, with no accessor,
+    // lock or allocation along the way.
     class Packet : public CLxImpl_FalloffPacket
     {
     public:
-        void setupMesh(CLxUser_Mesh& mesh);
+        void setupMeshes(std::vector<CLxUser_Mesh>& meshes);
         void update(Tool& tool);
 
+        // Bounds of the part centers over every layer.
         const std::pair<CLxVector, CLxVector> partBounds() const;
 
+        // Where the view event packet sits in tool vector stacks, which says which viewport
+        // a stack is for.  Set by the tool before the packet goes out.
+        void setViewOffset(uint32_t offset);
+
+        // Renders which part covers each pixel of the view, to be picked up by the next
+        // update.  vts is the draw's vector stack, whose viewport the render is kept under.
+        // Every viewport keeps its own render, so this does nothing unless that view or the
+        // meshes changed since it was last drawn.
+        void updateScreen(ILxUnknownID vts, CLxUser_View& view);
+
         double fp_Evaluate(LXtFVector, LXtPointID vrx, LXtPolygonID) override;
+        double fp_Screen(LXtObjectID vts, int x, int y) override;
 
     private:
-        CLxUser_Point m_pointAcc;
+        struct Layer
+        {
+            component::PartMap     partData;
+            component::WeightTable weights;
+            partCore::MeshInput    mesh;  // Kept for drawing the parts into the id buffer
+        };
 
-        component::PartMap   m_partData;
-        component::Cache     m_weightCache;
+        // Points the tables at the layers' current parts and weights.
+        void updateTables();
+
+        std::vector<Layer>   m_layers;
         global::ToolSettings m_settings;
+
+        uint32_t m_viewOffset{};
+
+        // What the evaluation reads.  Draws render views into it while the packet may be
+        // out, and update publishes them, so fp_Screen only ever reads finished buffers.
+        partCore::FalloffTables m_tables;
     };
 
 }  // namespace partFalloff
@@ -226,10 +488,9 @@ namespace falloffItem
         LxResult fall_SetMesh(ILxUnknownID mesh, LXtMatrix4 xfrm) override;
 
     private:
-        component::PartMap m_partData;
-        component::Cache   m_weightCache;
-        CLxUser_Point      m_pointAcc;
-        std::mutex         m_lock;
+        component::PartMapCache::MapPtr m_partData;  // Shared with other falloffs, never written
+        component::WeightTable          m_weights;
+        std::mutex                      m_lock;  // Only for fall_SetMesh, the lookups never take it
     };
 
     class Modifier : public CLxObjectRefModifierCore
@@ -0,0 +1,283 @@
+// Fires random rays at a random triangle soup and checks the BVH, one ray at a time and in
+// packets, against a brute force Möller-Trumbore pass over every triangle.  The leaf
+// kernels are checked against each other on the same blocks, ties included.
+
+#include <ThicknessChecker/Bvh.hxx>
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    using thicknessCore::Hit;
+    using thicknessCore::invalidIndex;
+    using thicknessCore::Isa;
+    using thicknessCore::Ray;
+    using thicknessCore::Triangle;
+    using thicknessCore::TriangleBlock;
+    using thicknessCore::Vec3;
+
+    int failures = 0;
+
+    void check(bool passed, const char* what, Isa isa)
+    {
+        if (passed)
+            return;
+
+        std::printf("FAILED: %s, %s\n", what, thicknessCore::isaName(isa));
+        ++failures;
+    }
+
+    // Xorshift, so the soup is the same everywhere.
+    struct Random
+    {
+        uint32_t state{ 0x2545F491u };
+
+        float next(float lo, float hi)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return lo + (hi - lo) * static_cast<float>(state >> 8) / static_cast<float>(1u << 24);
+        }
+
+        Vec3 point(float lo, float hi)
+        {
+            const auto x = next(lo, hi);
+            const auto y = next(lo, hi);
+            return { x, y, next(lo, hi) };
+        }
+    };
+
+    // Two triangles to a poly, so ignoring a poly has to skip both.
+    std::vector<Triangle> makeSoup(Random& random, uint32_t count)
+    {
+        std::vector<Triangle> tris;
+        for (auto i = 0u; i < count; ++i)
+        {
+            const auto centre = random.point(-1.0f, 1.0f);
+            Triangle   tri;
+            for (auto* corner : { &tri.v0, &tri.v1, &tri.v2 })
+            {
+                const auto offset = random.point(-0.1f, 0.1f);
+                for (auto a = 0u; a < 3u; ++a)
+                    (*corner)[a] = centre[a] + offset[a];
+            }
+            tri.poly = i / 2u;
+            tris.push_back(tri);
+        }
+        return tris;
+    }
+
+    std::vector<Ray> makeRays(Random& random, uint32_t count, uint32_t polyCount)
+    {
+        std::vector<Ray> rays;
+        for (auto i = 0u; i < count; ++i)
+        {
+            Ray  ray;
+            auto length = 0.0f;
+            ray.origin  = random.point(-1.5f, 1.5f);
+            ray.dir     = random.point(-1.0f, 1.0f);
+            for (auto a = 0u; a < 3u; ++a)
+                length += ray.dir[a] * ray.dir[a];
+            for (auto a = 0u; a < 3u; ++a)
+                ray.dir[a] /= std::sqrt(length);
+
+            // Some rays start past their origin, stop early or skip a poly, like the checker's.
+            if (i % 3u == 1u)
+                ray.tMin = 0.05f;
+            if (i % 5u == 2u)
+                ray.tMax = 1.0f;
+            if (i % 4u == 3u)
+                ray.ignorePoly = i % polyCount;
+            rays.push_back(ray);
+        }
+        return rays;
+    }
+
+    // The kernels' Möller-Trumbore, in the same order of operations.
+    bool intersectTriangle(const Vec3& v0, const Vec3& e1, const Vec3& e2, const Ray& ray, float& t)
+    {
+        const auto& o = ray.origin;
+        const auto& d = ray.dir;
+
+        const float px  = d[1] * e2[2] - d[2] * e2[1];
+        const float py  = d[2] * e2[0] - d[0] * e2[2];
+        const float pz  = d[0] * e2[1] - d[1] * e2[0];
+        const float det = e1[0] * px + e1[1] * py + e1[2] * pz;
+        if (!(std::fabs(det) > 1e-12f))
+            return false;
+
+        const float inv = 1.0f / det;
+        const float sx  = o[0] - v0[0];
+        const float sy  = o[1] - v0[1];
+        const float sz  = o[2] - v0[2];
+        const float u   = (sx * px + sy * py + sz * pz) * inv;
+
+        const float qx = sy * e1[2] - sz * e1[1];
+        const float qy = sz * e1[0] - sx * e1[2];
+        const float qz = sx * e1[1] - sy * e1[0];
+        const float v  = (d[0] * qx + d[1] * qy + d[2] * qz) * inv;
+        t              = (e2[0] * qx + e2[1] * qy + e2[2] * qz) * inv;
+        return u >= 0.0f && v >= 0.0f && u + v <= 1.0f;
+    }
+
+    Vec3 edge(const Vec3& from, const Vec3& to)
+    {
+        return { to[0] - from[0], to[1] - from[1], to[2] - from[2] };
+    }
+
+    Hit bruteForce(const std::vector<Triangle>& tris, const Ray& ray)
+    {
+        Hit hit;
+        hit.dist = std::min(ray.tMax, std::numeric_limits<float>::max());
+        for (const auto& tri : tris)
+        {
+            float t;
+            if (tri.poly != ray.ignorePoly && intersectTriangle(tri.v0, edge(tri.v0, tri.v1), edge(tri.v0, tri.v2), ray, t) && t > ray.tMin && t < hit.dist)
+            {
+                hit.dist = t;
+                hit.poly = tri.poly;
+            }
+        }
+        return hit.valid() ? hit : Hit{};
+    }
+
+    bool sameHit(const Hit& a, const Hit& b)
+    {
+        return a.poly == b.poly && (a.valid() ? a.dist == b.dist : !b.valid());
+    }
+
+    // Packs the triangles eight to a block, leaving the lanes past the end unused.
+    std::vector<TriangleBlock> makeBlocks(const std::vector<Triangle>& tris)
+    {
+        const auto                 width = thicknessCore::blockWidth;
+        std::vector<TriangleBlock> blocks((tris.size() + width - 1u) / width);
+        for (auto& block : blocks)
+            for (auto lane = 0u; lane < width; ++lane)
+            {
+                for (auto a = 0u; a < 3u; ++a)
+                    block.v0[a][lane] = block.e1[a][lane] = block.e2[a][lane] = 0.0f;
+                block.poly[lane] = invalidIndex;
+            }
+
+        for (auto i = 0u; i < tris.size(); ++i)
+        {
+            auto&      block = blocks[i / width];
+            const auto lane  = i % width;
+            const auto e1    = edge(tris[i].v0, tris[i].v1);
+            const auto e2    = edge(tris[i].v0, tris[i].v2);
+            for (auto a = 0u; a < 3u; ++a)
+            {
+                block.v0[a][lane] = tris[i].v0[a];
+                block.e1[a][lane] = e1[a];
+                block.e2[a][lane] = e2[a];
+            }
+            block.poly[lane] = tris[i].poly;
+        }
+        return blocks;
+    }
+
+    Hit runKernel(Isa isa, const std::vector<TriangleBlock>& blocks, const Ray& ray)
+    {
+        Hit hit;
+        hit.dist = std::min(ray.tMax, std::numeric_limits<float>::max());
+        thicknessCore::blockKernel(isa)(blocks.data(), static_cast<uint32_t>(blocks.size()), ray, hit.dist, hit.poly);
+        return hit.valid() ? hit : Hit{};
+    }
+}  // namespace
+
+int main()
+{
+    static constexpr Isa isas[] = { Isa::scalar, Isa::sse4, Isa::avx2 };
+
+    Random     random;
+    const auto tris      = makeSoup(random, 3000u);
+    const auto polyCount = static_cast<uint32_t>(tris.size() / 2u);
+    const auto rays      = makeRays(random, 2000u, polyCount);
+
+    std::vector<Hit> expected;
+    auto             hitCount = 0u;
+    for (const auto& ray : rays)
+    {
+        expected.push_back(bruteForce(tris, ray));
+        hitCount += expected.back().valid();
+    }
+    check(hitCount > rays.size() / 4u && hitCount < rays.size(), "the rays both hit and miss the soup", Isa::scalar);
+
+    thicknessCore::Bvh bvh;
+    bvh.build(tris);
+    check(bvh.triangleCount() == tris.size(), "the tree has every triangle", Isa::scalar);
+
+    // A small leaf's worth of the soup, with three copies of one triangle so a ray through
+    // it ties between lanes and blocks.
+    auto leaf = std::vector<Triangle>(tris.begin(), tris.begin() + 21);
+    leaf[4]   = { tris[100].v0, tris[100].v1, tris[100].v2, 9001u };
+    leaf[11]  = { tris[100].v0, tris[100].v1, tris[100].v2, 9002u };
+    leaf[13]  = { tris[100].v0, tris[100].v1, tris[100].v2, 9003u };
+    const auto blocks = makeBlocks(leaf);
+
+    // Fired at the copies' centre along their normal, from just in front of them.
+    const auto& copy   = tris[100];
+    const auto  e1     = edge(copy.v0, copy.v1);
+    const auto  e2     = edge(copy.v0, copy.v2);
+    Vec3        normal = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    const auto  length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    Ray         tied;
+    for (auto a = 0u; a < 3u; ++a)
+    {
+        tied.dir[a]    = normal[a] / length;
+        tied.origin[a] = (copy.v0[a] + copy.v1[a] + copy.v2[a]) / 3.0f - 0.001f * tied.dir[a];
+    }
+
+    for (auto isa : isas)
+    {
+        if (!thicknessCore::isaSupported(isa))
+        {
+            std::printf("skipped %s, the cpu doesn't support it\n", thicknessCore::isaName(isa));
+            continue;
+        }
+
+        bvh.setIsa(isa);
+        auto single = 0u;
+        for (auto i = 0u; i < rays.size(); ++i)
+        {
+            Hit hit;
+            const bool found = bvh.intersect(rays[i], hit);
+            single += found != expected[i].valid() || !sameHit(hit, expected[i]);
+        }
+        check(single == 0u, "intersect matches the brute force hits", isa);
+
+        // Whole packets, then a part filled one at the end.
+        auto packed = 0u;
+        for (auto first = 0u; first < rays.size(); first += thicknessCore::Bvh::packetWidth - 3u)
+        {
+            const auto count = std::min<uint32_t>(thicknessCore::Bvh::packetWidth, static_cast<uint32_t>(rays.size()) - first);
+            Hit        hits[thicknessCore::Bvh::packetWidth];
+            bvh.intersectPacket(&rays[first], count, hits);
+            for (auto r = 0u; r < count; ++r)
+                packed += !sameHit(hits[r], expected[first + r]);
+        }
+        check(packed == 0u, "intersectPacket matches the brute force hits", isa);
+
+        auto lanes = 0u;
+        for (const auto& ray : rays)
+            lanes += !sameHit(runKernel(isa, blocks, ray), bruteForce(leaf, ray));
+        check(lanes == 0u, "the block kernel matches the brute force hits", isa);
+
+        const auto tie = runKernel(isa, blocks, tied);
+        check(tie.poly == 9001u, "a tie goes to the earliest lane", isa);
+
+        auto ignored       = tied;
+        ignored.ignorePoly = 9001u;
+        check(runKernel(isa, blocks, ignored).poly == 9002u, "a tie skips the ignored poly", isa);
+    }
+
+    if (failures)
+        return 1;
+
+    std::printf("bvhTest passed\n");
+    return 0;
+}
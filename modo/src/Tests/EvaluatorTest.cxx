@@ -0,0 +1,201 @@
+// Edits a thick walled shell the way a user would, moving points and then cutting a hole
+// and adding a poly, and checks that the incremental evaluation after each edit gives
+// exactly what a full recast of the same snapshot does, while casting fewer rays.
+
+#include <ThicknessChecker/Engine.hxx>
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    using thicknessCore::Vec3;
+
+    int failures = 0;
+
+    void check(bool passed, const char* what, uint32_t rays)
+    {
+        if (passed)
+            return;
+
+        std::printf("FAILED: %s, %u rays a poly\n", what, rays);
+        ++failures;
+    }
+
+    // Quads between two spheres, sharing their points, with the ids a modo mesh would give.
+    struct Shell
+    {
+        std::vector<Vec3>                    points;
+        std::vector<std::array<uint32_t, 4>> quads;
+        std::vector<uint64_t>                ids;
+    };
+
+    static constexpr uint32_t segments = 48u;
+    static constexpr uint32_t rings    = 24u;
+
+    uint32_t pointIndex(uint32_t wall, uint32_t u, uint32_t v)
+    {
+        return (wall * (rings + 1u) + v) * segments + u % segments;
+    }
+
+    Shell makeShell()
+    {
+        const auto pi = 3.14159265f;
+
+        Shell shell;
+        for (auto wall = 0u; wall < 2u; ++wall)
+            for (auto v = 0u; v <= rings; ++v)
+                for (auto u = 0u; u < segments; ++u)
+                {
+                    const auto radius = wall ? 0.8f : 1.0f;
+                    const auto theta  = 2.0f * pi * static_cast<float>(u) / static_cast<float>(segments);
+                    const auto phi    = pi * static_cast<float>(v) / static_cast<float>(rings);
+                    shell.points.push_back({ radius * std::sin(phi) * std::cos(theta), radius * std::sin(phi) * std::sin(theta), radius * std::cos(phi) });
+                }
+
+        for (auto wall = 0u; wall < 2u; ++wall)
+            for (auto v = 0u; v < rings; ++v)
+                for (auto u = 0u; u < segments; ++u)
+                {
+                    shell.quads.push_back({ pointIndex(wall, u, v), pointIndex(wall, u + 1u, v), pointIndex(wall, u + 1u, v + 1u), pointIndex(wall, u, v + 1u) });
+                    shell.ids.push_back(shell.ids.size() + 1000u);
+                }
+        return shell;
+    }
+
+    // One ray per quad from its middle across the wall, outer quads firing in and inner
+    // ones out.
+    thicknessCore::MeshInput makeInput(const Shell& shell)
+    {
+        thicknessCore::MeshInput input;
+        input.pointCount = static_cast<uint32_t>(shell.points.size());
+        input.triOffsets.push_back(0u);
+        input.pointOffsets.push_back(0u);
+        for (auto i = 0u; i < shell.quads.size(); ++i)
+        {
+            const auto& quad = shell.quads[i];
+            const auto& a    = shell.points[quad[0]];
+            const auto& b    = shell.points[quad[1]];
+            const auto& c    = shell.points[quad[2]];
+            const auto& d    = shell.points[quad[3]];
+            input.tris.push_back({ a, b, c, i });
+            input.tris.push_back({ a, c, d, i });
+            input.triOffsets.push_back(static_cast<uint32_t>(input.tris.size()));
+            input.points.insert(input.points.end(), quad.begin(), quad.end());
+            input.pointOffsets.push_back(static_cast<uint32_t>(input.points.size()));
+            input.polyIds.push_back(shell.ids[i]);
+
+            thicknessCore::Ray ray;
+            auto               length = 0.0f;
+            for (auto k = 0u; k < 3u; ++k)
+            {
+                ray.origin[k] = (a[k] + b[k] + c[k] + d[k]) * 0.25f;
+                length += ray.origin[k] * ray.origin[k];
+            }
+            const auto sign = length > 0.81f ? -1.0f : 1.0f;
+            for (auto k = 0u; k < 3u; ++k)
+                ray.dir[k] = sign * ray.origin[k] / std::sqrt(length);
+            ray.ignorePoly = i;
+            input.rays.push_back(ray);
+        }
+        return input;
+    }
+
+    bool same(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        // Misses are infinite on both sides, so plain equality covers them.
+        for (auto i = 0u; i < a.size(); ++i)
+            if (a[i] != b[i])
+                return false;
+        return true;
+    }
+
+    // Evaluates the edited shell incrementally, and from scratch to compare against.
+    void checkEdit(thicknessCore::Evaluator& incremental, const Shell& shell, const thicknessCore::Sampling& sampling, bool expectRays, const char* what)
+    {
+        thicknessCore::Evaluator full;
+        full.evaluate(makeInput(shell), sampling, false);
+        incremental.evaluate(makeInput(shell), sampling, true);
+
+        char message[128];
+        std::snprintf(message, sizeof(message), "%s: the distances match a full recast", what);
+        check(same(incremental.distances(), full.distances()), message, sampling.rays);
+        std::snprintf(message, sizeof(message), "%s: the samples match a full recast", what);
+        check(same(incremental.samples(), full.samples()), message, sampling.rays);
+        std::snprintf(message, sizeof(message), "%s: the point distances match a full recast", what);
+        check(same(incremental.pointDistances(), full.pointDistances()), message, sampling.rays);
+
+        std::snprintf(message, sizeof(message), "%s: only some rays are recast", what);
+        const auto recast = incremental.lastRayCount();
+        check(expectRays ? recast > 0u && recast < full.lastRayCount() / 4u : recast == 0u, message, sampling.rays);
+    }
+}  // namespace
+
+int main()
+{
+    thicknessCore::Sampling cone;
+    cone.rays      = 8u;
+    cone.coneAngle = 0.3f;
+    cone.statistic = thicknessCore::Statistic::median;
+
+    for (const auto& sampling : { thicknessCore::Sampling{}, cone })
+    {
+        auto                     shell = makeShell();
+        thicknessCore::Evaluator incremental;
+        incremental.evaluate(makeInput(shell), sampling, true);
+        check(incremental.lastRayCount() == shell.quads.size() * sampling.rays, "the first evaluation casts every ray", sampling.rays);
+
+        checkEdit(incremental, shell, sampling, false, "no edit");
+
+        // Push a patch of the inner wall out, thinning the shell there.
+        for (auto v = 10u; v < 14u; ++v)
+            for (auto u = 5u; u < 9u; ++u)
+            {
+                auto& point = shell.points[pointIndex(1u, u, v)];
+                for (auto& coord : point)
+                    coord *= 1.1f;
+            }
+        checkEdit(incremental, shell, sampling, true, "moved points");
+
+        // Cut a hole in the outer wall, so the inner rays under it miss, and add a plate
+        // inside the wall elsewhere with a new id.
+        Shell cut;
+        cut.points = shell.points;
+        for (auto i = 0u; i < shell.quads.size(); ++i)
+        {
+            const auto u = i % segments;
+            const auto v = i / segments;
+            if (v >= 4u && v < 7u && u >= 30u && u < 34u)
+                continue;
+
+            cut.quads.push_back(shell.quads[i]);
+            cut.ids.push_back(shell.ids[i]);
+        }
+
+        const auto base = static_cast<uint32_t>(cut.points.size());
+        for (auto corner = 0u; corner < 4u; ++corner)
+        {
+            const auto& inner = shell.points[pointIndex(1u, 20u + (corner == 1u || corner == 2u), 18u + (corner >= 2u))];
+            cut.points.push_back({ inner[0] * 1.1f, inner[1] * 1.1f, inner[2] * 1.1f });
+        }
+        cut.quads.insert(cut.quads.begin() + 100, { base, base + 1u, base + 2u, base + 3u });
+        cut.ids.insert(cut.ids.begin() + 100, 1u);
+        checkEdit(incremental, cut, sampling, true, "cut a hole and added a poly");
+
+        auto missed = 0u;
+        for (auto d : incremental.distances())
+            missed += std::isinf(d);
+        check(missed > 0u, "rays under the hole miss", sampling.rays);
+    }
+
+    if (failures)
+        return 1;
+
+    std::printf("evaluatorTest passed\n");
+    return 0;
+}
@@ -0,0 +1,290 @@
+// Hammers the falloff packet's tables from many threads, the way a deformer stack does,
+// while views are drawn alongside and every round of lookups is followed by an update that
+// points the tables at freshly built weights.  Meant to run under the thread sanitizer,
+// but the values read are checked too.
+
+#include <ModelingFalloff/FalloffTables.hxx>
+#include <ModelingFalloff/Islands.hxx>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    static constexpr uint32_t layerCount  = 3u;
+    static constexpr uint32_t viewCount   = 3u;
+    static constexpr uint32_t readerCount = 16u;
+    static constexpr uint32_t roundCount  = 40u;
+    static constexpr uint32_t lookups     = 4096u;  // Per reader per round
+
+    // A layer of the stand-in mesh, a row of separate cubes, so one part per cube.  Point
+    // ids are unique across layers, like the SDK's.
+    struct Layer
+    {
+        partCore::MeshInput   mesh;
+        partCore::Islands     islands;
+        util::IdTable         parts;
+        std::vector<float>    weights[2];  // Swapped between on every update
+    };
+
+    void buildLayer(Layer& layer, uint32_t index)
+    {
+        static const uint32_t faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+
+        auto& mesh = layer.mesh;
+        mesh.polyOffsets.push_back(0u);
+        const auto cubes = 20u + index * 7u;
+        for (auto cube = 0u; cube < cubes; ++cube)
+        {
+            const auto base = static_cast<uint32_t>(mesh.positions.size());
+            const auto x    = static_cast<float>(cube) * 1.5f;
+            const auto y    = static_cast<float>(index) * 2.0f;
+            for (auto i = 0u; i < 8u; ++i)
+            {
+                mesh.positions.push_back({ x + (i & 1u ? 1.0f : 0.0f), y + (i & 2u ? 1.0f : 0.0f), i & 4u ? 1.0f : 0.0f });
+                mesh.pointIds.push_back((static_cast<uintptr_t>(index + 1u) << 20u) + (base + i) * 16u);
+            }
+            for (const auto& face : faces)
+            {
+                for (auto corner : face)
+                    mesh.polyPoints.push_back(base + corner);
+                mesh.polyOffsets.push_back(static_cast<uint32_t>(mesh.polyPoints.size()));
+            }
+        }
+        mesh.selected.assign(mesh.positions.size(), 0u);
+
+        layer.islands = partCore::findIslands(mesh);
+        layer.parts.build(mesh.pointIds, layer.islands.pointIsland);
+    }
+
+    // Every round has its own weights, so a stale read can't pass for a fresh one.
+    float weightFor(uint32_t round, uint32_t part)
+    {
+        return static_cast<float>(round * 16u + part % 8u);
+    }
+
+    // Orthographic view looking down -z, moved a little every round so every draw renders.
+    std::vector<partCore::ScreenTriangle> project(const Layer* layers, uint32_t view, uint32_t round, std::vector<uint32_t>& starts)
+    {
+        const auto scale  = 6.0f + static_cast<float>(view);
+        const auto offset = static_cast<float>(round % 5u);
+
+        std::vector<partCore::ScreenTriangle> triangles;
+        std::vector<partCore::Vec3>           screen;
+        starts.assign(layerCount, 0u);
+        auto nextId = 0u;
+        for (auto i = 0u; i < layerCount; ++i)
+        {
+            const auto& layer = layers[i];
+            screen.clear();
+            for (const auto& p : layer.mesh.positions)
+                screen.push_back({ 4.0f + offset + p[0] * scale, 4.0f + p[1] * scale, 10.0f - p[2] });
+
+            partCore::appendIslandTriangles(layer.islands, layer.mesh, screen, nextId, triangles);
+            starts[i] = nextId;
+            nextId += layer.islands.count();
+        }
+        return triangles;
+    }
+
+    // Lets the workers go one round at a time, and waits for all of them to finish it.
+    class Rounds
+    {
+    public:
+        explicit Rounds(uint32_t workers) : m_workers(workers) {}
+
+        void start(uint32_t round)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_round   = round;
+            m_waiting = m_workers;
+            ++m_started;
+            m_changed.notify_all();
+        }
+
+        void waitForWorkers()
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_changed.wait(lock, [&]() { return m_waiting == 0u; });
+        }
+
+        // Blocks until a round after the last one seen starts, and returns it.
+        uint32_t next(uint32_t& seen)
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_changed.wait(lock, [&]() { return m_started != seen; });
+            seen = m_started;
+            return m_round;
+        }
+
+        void finished()
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (--m_waiting == 0u)
+                m_changed.notify_all();
+        }
+
+    private:
+        std::mutex              m_lock;
+        std::condition_variable m_changed;
+        uint32_t                m_workers;
+        uint32_t                m_waiting{};
+        uint32_t                m_round{};
+        uint32_t                m_started{};  // Rounds started so far
+    };
+}  // namespace
+
+int main()
+{
+    Layer layers[layerCount];
+    for (auto i = 0u; i < layerCount; ++i)
+        buildLayer(layers[i], i);
+
+    std::vector<uintptr_t> ids;
+    std::vector<uint32_t>  routes;
+    for (auto i = 0u; i < layerCount; ++i)
+    {
+        ids.insert(ids.end(), layers[i].mesh.pointIds.begin(), layers[i].mesh.pointIds.end());
+        routes.resize(ids.size(), i);
+    }
+
+    partCore::FalloffTables tables;
+    tables.setRouting(ids, routes);
+
+    // Round r's lookups and draws run against what update r set up.  Round zero is the end.
+    Rounds                   rounds(readerCount + 1u);
+    std::atomic<uint32_t>    failures{ 0u };
+    std::vector<std::thread> workers;
+    for (auto reader = 0u; reader < readerCount; ++reader)
+        workers.emplace_back(
+            [&, reader]()
+            {
+                auto state = 0x9E3779B9u * (reader + 1u);
+                auto next  = [&]()
+                {
+                    state ^= state << 13u;
+                    state ^= state >> 17u;
+                    state ^= state << 5u;
+                    return state;
+                };
+
+                auto seen = 0u;
+                for (auto round = rounds.next(seen); round; round = rounds.next(seen))
+                {
+                    for (auto i = 0u; i < lookups; ++i)
+                    {
+                        const auto  layer = next() % layerCount;
+                        const auto& mesh  = layers[layer].mesh;
+                        const auto  point = next() % static_cast<uint32_t>(mesh.pointIds.size());
+                        const auto  part  = layers[layer].islands.pointIsland[point];
+                        if (tables.weightOf(mesh.pointIds[point]) != weightFor(round, part))
+                            ++failures;
+
+                        // Only the round's own weights, or the full weight off every part.
+                        const auto value = tables.weightAt(next() % (viewCount + 1u), static_cast<int>(next() % 400u), static_cast<int>(next() % 40u));
+                        if (value != 1.0 && (value < weightFor(round, 0u) || value > weightFor(round, 7u)))
+                            ++failures;
+                    }
+                    rounds.finished();
+                }
+            });
+
+    // Views are drawn while the lookups go on, and only published by the next update.
+    workers.emplace_back(
+        [&]()
+        {
+            std::vector<uint32_t> starts;
+            auto                  seen = 0u;
+            for (auto round = rounds.next(seen); round; round = rounds.next(seen))
+            {
+                for (auto view = 0u; view < viewCount; ++view)
+                {
+                    const auto triangles = project(layers, view, round, starts);
+                    if (auto* screen = tables.draw(view, round))
+                    {
+                        screen->starts = starts;
+                        screen->ids.render(400u, 40u, triangles);
+                    }
+                }
+                rounds.finished();
+            }
+        });
+
+    for (auto round = 1u; round <= roundCount; ++round)
+    {
+        // What Packet::update does with the packet back: new weights in the other buffers,
+        // the tables pointed at them, and the views drawn since published.
+        std::vector<partCore::FalloffTables::Layer> tableLayers;
+        for (auto& layer : layers)
+        {
+            auto& weights = layer.weights[round & 1u];
+            weights.resize(layer.islands.count());
+            for (auto part = 0u; part < weights.size(); ++part)
+                weights[part] = weightFor(round, part);
+            tableLayers.push_back({ &layer.parts, weights.data(), static_cast<uint32_t>(weights.size()) });
+        }
+        tables.setLayers(std::move(tableLayers));
+        tables.setScale(1.0);
+        tables.publishScreens();
+
+        rounds.start(round);
+        rounds.waitForWorkers();
+    }
+    rounds.start(0u);
+    for (auto& worker : workers)
+        worker.join();
+
+    // Every view drawn in the last round is still waiting, so publishing puts them in.  Each
+    // view has to read back its own render, which differs from the others, and not just the
+    // one drawn last.
+    tables.publishScreens();
+    auto expectedAt = [&](uint32_t view, std::vector<double>& values)
+    {
+        std::vector<uint32_t> starts;
+        const auto            triangles = project(layers, view, roundCount, starts);
+        partCore::IdBuffer    expected;
+        expected.render(400u, 40u, triangles);
+        values.assign(400u * 40u, 1.0);
+        for (auto y = 0; y < 40; ++y)
+            for (auto x = 0; x < 400; ++x)
+            {
+                const auto id = expected.at(x, y);
+                if (id == partCore::invalidIndex)
+                    continue;
+
+                auto layer = layerCount - 1u;
+                while (id < starts[layer])
+                    --layer;
+                values[y * 400u + x] = weightFor(roundCount, id - starts[layer]);
+            }
+    };
+
+    std::vector<double> values[viewCount];
+    auto                mismatches = 0u;
+    for (auto view = 0u; view < viewCount; ++view)
+    {
+        expectedAt(view, values[view]);
+        for (auto y = 0; y < 40; ++y)
+            for (auto x = 0; x < 400; ++x)
+                mismatches += tables.weightAt(view, x, y) != values[view][y * 400u + x];
+    }
+
+    if (values[0] == values[1] || values[1] == values[2])
+    {
+        std::printf("FAILED: the views drawn don't differ, so can't tell them apart\n");
+        return 1;
+    }
+
+    if (failures || mismatches)
+    {
+        std::printf("FAILED: %u lookups gave the wrong weight, %u pixels of the views\n", failures.load(), mismatches);
+        return 1;
+    }
+
+    std::printf("falloffStressTest passed\n");
+    return 0;
+}
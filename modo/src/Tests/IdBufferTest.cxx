@@ -0,0 +1,171 @@
+// Renders islands through a synthetic camera, the way the tool packet does for a view, and
+// checks the id buffer against a brute force pass over every pixel and triangle.
+
+#include <ModelingFalloff/IdBuffer.hxx>
+#include <ModelingFalloff/Islands.hxx>
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool passed, const char* what)
+    {
+        if (passed)
+            return;
+
+        std::printf("FAILED: %s\n", what);
+        ++failures;
+    }
+
+    // Pinhole camera at eye looking down -z, with the image centered on the view.  Depth is
+    // the distance in front of the eye, so nearer is smaller, like the packet's.
+    struct Camera
+    {
+        partCore::Vec3 eye;
+        float          focal;
+        uint32_t       width;
+        uint32_t       height;
+
+        partCore::Vec3 toScreen(const partCore::Vec3& p) const
+        {
+            const auto depth = eye[2] - p[2];
+            return { 0.5f * width + focal * (p[0] - eye[0]) / depth, 0.5f * height - focal * (p[1] - eye[1]) / depth, depth };
+        }
+    };
+
+    void addCube(partCore::MeshInput& mesh, float x, float y, float z, float size)
+    {
+        static const uint32_t faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+
+        const auto base = static_cast<uint32_t>(mesh.positions.size());
+        for (auto i = 0u; i < 8u; ++i)
+            mesh.positions.push_back({ x + (i & 1u ? size : 0.0f), y + (i & 2u ? size : 0.0f), z + (i & 4u ? size : 0.0f) });
+        for (const auto& face : faces)
+        {
+            for (auto corner : face)
+                mesh.polyPoints.push_back(base + corner);
+            mesh.polyOffsets.push_back(static_cast<uint32_t>(mesh.polyPoints.size()));
+        }
+    }
+
+    // The same coverage and depth test as the rasterizer, one pixel at a time.
+    std::vector<uint32_t> bruteForce(uint32_t width, uint32_t height, const std::vector<partCore::ScreenTriangle>& triangles)
+    {
+        std::vector<uint32_t> ids(static_cast<size_t>(width) * height, partCore::invalidIndex);
+        std::vector<float>    depths(ids.size(), std::numeric_limits<float>::infinity());
+        for (const auto& tri : triangles)
+        {
+            const auto& a    = tri.corners[0];
+            const auto& b    = tri.corners[1];
+            const auto& c    = tri.corners[2];
+            const auto  area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+            if (!(std::abs(area) > 1e-12f))
+                continue;
+
+            const auto inv = 1.0f / area;
+            for (auto y = 0u; y < height; ++y)
+                for (auto x = 0u; x < width; ++x)
+                {
+                    const auto px = static_cast<float>(x) + 0.5f;
+                    const auto py = static_cast<float>(y) + 0.5f;
+                    const auto wa = ((b[0] - px) * (c[1] - py) - (b[1] - py) * (c[0] - px)) * inv;
+                    const auto wb = ((c[0] - px) * (a[1] - py) - (c[1] - py) * (a[0] - px)) * inv;
+                    const auto wc = 1.0f - wa - wb;
+                    if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+                        continue;
+
+                    const auto z     = wa * a[2] + wb * b[2] + wc * c[2];
+                    const auto pixel = static_cast<size_t>(y) * width + x;
+                    if (z < depths[pixel])
+                    {
+                        depths[pixel] = z;
+                        ids[pixel]    = tri.id;
+                    }
+                }
+        }
+        return ids;
+    }
+
+    std::vector<partCore::ScreenTriangle> project(const partCore::MeshInput& mesh, const partCore::Islands& islands, const Camera& camera, uint32_t firstId)
+    {
+        std::vector<partCore::Vec3> screen;
+        for (const auto& p : mesh.positions)
+            screen.push_back(camera.toScreen(p));
+
+        std::vector<partCore::ScreenTriangle> triangles;
+        partCore::appendIslandTriangles(islands, mesh, screen, firstId, triangles);
+        return triangles;
+    }
+
+    uint32_t idAt(const partCore::IdBuffer& buffer, const Camera& camera, const partCore::Vec3& p)
+    {
+        const auto s = camera.toScreen(p);
+        return buffer.at(static_cast<int>(s[0]), static_cast<int>(s[1]));
+    }
+}  // namespace
+
+int main()
+{
+    // A cube, a second one behind it and offset so it peeks out, and a third on its own.
+    partCore::MeshInput mesh;
+    mesh.polyOffsets.push_back(0u);
+    addCube(mesh, 0.0f, 0.0f, 0.0f, 1.0f);
+    addCube(mesh, 0.5f, 0.5f, -3.0f, 1.0f);
+    addCube(mesh, -3.0f, -2.0f, 0.0f, 1.0f);
+    mesh.selected.assign(mesh.positions.size(), 0u);
+
+    const auto islands = partCore::findIslands(mesh);
+    check(islands.count() == 3u, "three cubes make three islands");
+
+    const auto         firstId   = 100u;
+    const Camera       camera    = { { 0.5f, 0.5f, 10.0f }, 400.0f, 320u, 240u };
+    const auto         triangles = project(mesh, islands, camera, firstId);
+    partCore::IdBuffer buffer;
+    buffer.render(camera.width, camera.height, triangles);
+
+    check(buffer.width() == camera.width && buffer.height() == camera.height, "the buffer takes the view's size");
+    check(buffer.at(-1, 0) == partCore::invalidIndex && buffer.at(0, -1) == partCore::invalidIndex, "pixels before the buffer are empty");
+    check(buffer.at(320, 0) == partCore::invalidIndex && buffer.at(0, 240) == partCore::invalidIndex, "pixels past the buffer are empty");
+
+    const auto front  = firstId + islands.pointIsland[0];
+    const auto behind = firstId + islands.pointIsland[8];
+    const auto alone  = firstId + islands.pointIsland[16];
+    check(idAt(buffer, camera, { 0.25f, 0.25f, 1.0f }) == front, "the front cube covers its middle");
+    check(idAt(buffer, camera, { 0.75f, 0.75f, 1.0f }) == front, "the front cube hides the cube behind it");
+    check(idAt(buffer, camera, { 1.4f, 1.4f, -2.0f }) == behind, "the cube behind shows where the front one doesn't cover");
+    check(idAt(buffer, camera, { -2.5f, -1.5f, 1.0f }) == alone, "the cube on its own is drawn");
+    check(idAt(buffer, camera, { 3.0f, -3.0f, 0.0f }) == partCore::invalidIndex, "pixels no cube covers are empty");
+
+    // Every pixel, the banded render against the brute force one.
+    auto checkMatches = [&](const partCore::IdBuffer& ids, const Camera& view, const std::vector<partCore::ScreenTriangle>& tris, const char* what)
+    {
+        const auto expected   = bruteForce(view.width, view.height, tris);
+        auto       mismatches = 0u;
+        for (auto y = 0u; y < view.height; ++y)
+            for (auto x = 0u; x < view.width; ++x)
+                mismatches += ids.at(static_cast<int>(x), static_cast<int>(y)) != expected[static_cast<size_t>(y) * view.width + x];
+        check(mismatches == 0u, what);
+    };
+    checkMatches(buffer, camera, triangles, "every pixel matches the brute force render");
+
+    // Drawing again for a different view replaces the old render completely.
+    const Camera other          = { { -1.0f, 0.0f, 6.0f }, 150.0f, 97u, 131u };
+    const auto   otherTriangles = project(mesh, islands, other, 0u);
+    buffer.render(other.width, other.height, otherTriangles);
+    check(buffer.width() == other.width && buffer.height() == other.height, "a new render takes the new view's size");
+    checkMatches(buffer, other, otherTriangles, "a render into a used buffer matches the brute force render");
+
+    buffer.clear();
+    check(buffer.at(0, 0) == partCore::invalidIndex, "a cleared buffer is empty");
+
+    if (failures)
+        return 1;
+
+    std::printf("idBufferTest passed\n");
+    return 0;
+}
@@ -0,0 +1,229 @@
+// Checks partCore's gradient noise against CLxPerlin, which the random falloff mode has
+// always used.  The reference below is a plain transcription of the public domain Perlin
+// class CLxPerlin is built on, templated on precision the same way.
+
+#include <ModelingFalloff/Noise.hxx>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool passed, const char* what, int seed)
+    {
+        if (passed)
+            return;
+
+        std::printf("FAILED: %s, seed %d\n", what, seed);
+        ++failures;
+    }
+
+    template <typename T>
+    class ReferencePerlin
+    {
+    public:
+        ReferencePerlin(int octaves, T frequency, T amplitude, int seed)
+            : m_octaves(octaves), m_frequency(frequency), m_amplitude(amplitude), m_seed(seed)
+        {
+        }
+
+        T eval(const double* pos)
+        {
+            T vec[3] = { static_cast<T>(pos[0]), static_cast<T>(pos[1]), static_cast<T>(pos[2]) };
+            for (auto& v : vec)
+                v *= m_frequency;
+
+            T result    = 0;
+            T amplitude = m_amplitude;
+            for (auto i = 0; i < m_octaves; ++i)
+            {
+                result += noise3(vec) * amplitude;
+                for (auto& v : vec)
+                    v *= 2;
+                amplitude *= static_cast<T>(0.5);
+            }
+            return result;
+        }
+
+    private:
+        static constexpr int B  = 1024;
+        static constexpr int BM = B - 1;
+        static constexpr int N  = 0x1000;
+
+        static T sCurve(T t)
+        {
+            return t * t * (3 - 2 * t);
+        }
+
+        static T lerp(T t, T a, T b)
+        {
+            return a + t * (b - a);
+        }
+
+        static void normalize2(T v[2])
+        {
+            const T s = 1 / static_cast<T>(std::sqrt(v[0] * v[0] + v[1] * v[1]));
+            v[0] *= s;
+            v[1] *= s;
+        }
+
+        static void normalize3(T v[3])
+        {
+            const T s = 1 / static_cast<T>(std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]));
+            v[0] *= s;
+            v[1] *= s;
+            v[2] *= s;
+        }
+
+        void init()
+        {
+            int i = 0;
+            for (; i < B; ++i)
+            {
+                m_p[i]  = i;
+                m_g1[i] = static_cast<T>((std::rand() % (B + B)) - B) / B;
+                for (auto j = 0; j < 2; ++j)
+                    m_g2[i][j] = static_cast<T>((std::rand() % (B + B)) - B) / B;
+                normalize2(m_g2[i]);
+                for (auto j = 0; j < 3; ++j)
+                    m_g3[i][j] = static_cast<T>((std::rand() % (B + B)) - B) / B;
+                normalize3(m_g3[i]);
+            }
+
+            while (--i)
+            {
+                const int k = m_p[i];
+                const int j = std::rand() % B;
+                m_p[i]      = m_p[j];
+                m_p[j]      = k;
+            }
+
+            for (i = 0; i < B + 2; ++i)
+            {
+                m_p[B + i] = m_p[i];
+                for (auto j = 0; j < 3; ++j)
+                    m_g3[B + i][j] = m_g3[i][j];
+            }
+        }
+
+        T noise3(const T vec[3])
+        {
+            if (m_start)
+            {
+                std::srand(m_seed);
+                m_start = false;
+                init();
+            }
+
+            int b0[3];
+            int b1[3];
+            T   r0[3];
+            T   r1[3];
+            for (auto a = 0; a < 3; ++a)
+            {
+                const T t = vec[a] + N;
+                b0[a]     = static_cast<int>(t) & BM;
+                b1[a]     = (b0[a] + 1) & BM;
+                r0[a]     = t - static_cast<int>(t);
+                r1[a]     = r0[a] - 1;
+            }
+
+            const int i   = m_p[b0[0]];
+            const int j   = m_p[b1[0]];
+            const int b00 = m_p[i + b0[1]];
+            const int b10 = m_p[j + b0[1]];
+            const int b01 = m_p[i + b1[1]];
+            const int b11 = m_p[j + b1[1]];
+
+            const T sx = sCurve(r0[0]);
+            const T sy = sCurve(r0[1]);
+            const T sz = sCurve(r0[2]);
+
+            auto at3 = [&](int index, T rx, T ry, T rz) { return rx * m_g3[index][0] + ry * m_g3[index][1] + rz * m_g3[index][2]; };
+
+            T       a = lerp(sx, at3(b00 + b0[2], r0[0], r0[1], r0[2]), at3(b10 + b0[2], r1[0], r0[1], r0[2]));
+            T       b = lerp(sx, at3(b01 + b0[2], r0[0], r1[1], r0[2]), at3(b11 + b0[2], r1[0], r1[1], r0[2]));
+            const T c = lerp(sy, a, b);
+            a         = lerp(sx, at3(b00 + b1[2], r0[0], r0[1], r1[2]), at3(b10 + b1[2], r1[0], r0[1], r1[2]));
+            b         = lerp(sx, at3(b01 + b1[2], r0[0], r1[1], r1[2]), at3(b11 + b1[2], r1[0], r1[1], r1[2]));
+            const T d = lerp(sy, a, b);
+            return lerp(sz, c, d);
+        }
+
+        int  m_octaves;
+        T    m_frequency;
+        T    m_amplitude;
+        int  m_seed;
+        bool m_start{ true };
+        int  m_p[B + B + 2];
+        T    m_g1[B + B + 2];
+        T    m_g2[B + B + 2][2];
+        T    m_g3[B + B + 2][3];
+    };
+}  // namespace
+
+int main()
+{
+    // Points spread over a few lattice cells either side of zero, plus an odd count so the
+    // AVX2 run has a scalar tail.
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    for (auto i = 0u; i < 1003u; ++i)
+    {
+        x.push_back(static_cast<float>(i % 97u) * 0.173f - 8.0f);
+        y.push_back(static_cast<float>(i % 61u) * -0.291f + 9.0f);
+        z.push_back(static_cast<float>(i) * 0.0371f - 18.0f);
+    }
+    const auto count = static_cast<uint32_t>(x.size());
+
+    for (auto seed : { 0, 1, 7, 12345, -3 })
+    {
+        const partCore::GradientNoise noise(4u, 1.0f, 1.0f, seed);
+
+        // The float class is what the falloff item used, and is matched exactly.  The tool
+        // used the double one, which only differs by float rounding.
+        ReferencePerlin<float>  single(4, 1.0f, 1.0f, seed);
+        ReferencePerlin<double> precise(4, 1.0, 1.0, seed);
+        std::vector<float>      expected(count);
+        auto                    preciseOff = 0u;
+        auto                    evalOff    = 0u;
+        for (auto i = 0u; i < count; ++i)
+        {
+            const double pos[3] = { x[i], y[i], z[i] };
+            expected[i]         = single.eval(pos);
+            preciseOff += std::abs(precise.eval(pos) - expected[i]) > 1e-3;
+            evalOff += noise.eval(x[i], y[i], z[i]) != expected[i];
+        }
+        check(evalOff == 0u, "eval matches the float CLxPerlin", seed);
+        check(preciseOff == 0u, "the double CLxPerlin is within 1e-3 of the float one", seed);
+
+        for (auto isa : { partCore::Isa::scalar, partCore::Isa::avx2 })
+        {
+            if (!partCore::isaSupported(isa))
+            {
+                std::printf("skipped %s, the cpu doesn't support it\n", partCore::isaName(isa));
+                continue;
+            }
+
+            auto run = noise;
+            run.setIsa(isa);
+            std::vector<float> values(count);
+            run.evalRun(x.data(), y.data(), z.data(), count, values.data());
+            auto runOff = 0u;
+            for (auto i = 0u; i < count; ++i)
+                runOff += values[i] != expected[i];
+            check(runOff == 0u, isa == partCore::Isa::scalar ? "scalar evalRun matches the float CLxPerlin" : "AVX2 evalRun matches the float CLxPerlin", seed);
+        }
+    }
+
+    if (failures)
+        return 1;
+
+    std::printf("noiseTest passed\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Summarizes a spread of distances, enough of them that summarize merges several chunks,
+// and checks the counts, range, mean and percentiles against the sorted distances.
+
+#include <ThicknessChecker/Stats.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool passed, const char* what)
+    {
+        if (passed)
+            return;
+
+        std::printf("FAILED: %s\n", what);
+        ++failures;
+    }
+
+    // The sketch's rank for q, then the distance at that rank.
+    float exactQuantile(const std::vector<float>& sorted, float q)
+    {
+        const auto rank = static_cast<uint64_t>(q * static_cast<float>(sorted.size() - 1u));
+        return sorted[rank];
+    }
+
+    bool withinAccuracy(float value, float expected, float accuracy)
+    {
+        // A little over, for the float rounding in the bucket maths.
+        return std::abs(value - expected) <= expected * accuracy * 1.001f;
+    }
+}  // namespace
+
+int main()
+{
+    static constexpr float accuracy    = 0.01f;  // The sketch's default
+    static constexpr float quantiles[] = { 0.0f, 0.01f, 0.1f, 0.25f, 0.5f, 0.75f, 0.9f, 0.99f, 1.0f };
+
+    // Spread over five decades, with every seventh a miss and a few touching.
+    std::vector<float> distances;
+    std::vector<float> hits;
+    auto               misses = 0u;
+    for (auto i = 0u; i < 70000u; ++i)
+    {
+        float d = std::pow(10.0f, -3.0f + 5.0f * static_cast<float>((i * 7919u) % 10007u) / 10007.0f);
+        if (i % 7u == 3u)
+        {
+            d = std::numeric_limits<float>::infinity();
+            ++misses;
+        }
+        else if (i % 1000u == 10u)
+        {
+            d = 0.0f;
+        }
+
+        distances.push_back(d);
+        if (std::isfinite(d))
+            hits.push_back(d);
+    }
+    std::sort(hits.begin(), hits.end());
+
+    const auto summary = thicknessCore::summarize(distances.data(), static_cast<uint32_t>(distances.size()));
+    check(summary.hitCount == hits.size(), "every finite distance is a hit");
+    check(summary.missCount == misses, "every infinite distance is a miss");
+    check(summary.min == hits.front() && summary.max == hits.back(), "the range is the smallest and largest hit");
+
+    const auto mean = std::accumulate(hits.begin(), hits.end(), 0.0) / static_cast<double>(hits.size());
+    check(std::abs(summary.mean - mean) <= mean * 1e-9, "the mean is the mean of the hits");
+
+    check(summary.sketch.count() == hits.size(), "the sketch has every hit");
+    for (auto q : quantiles)
+    {
+        const auto expected = exactQuantile(hits, q);
+        const auto value    = summary.sketch.quantile(q);
+        if (!withinAccuracy(value, expected, accuracy))
+            std::printf("q %g: %g, expected %g\n", q, value, expected);
+        check(withinAccuracy(value, expected, accuracy), "percentiles are within the sketch's accuracy");
+    }
+
+    // Merging two halves gives the same sketch as adding everything to one.
+    thicknessCore::QuantileSketch whole;
+    thicknessCore::QuantileSketch front;
+    thicknessCore::QuantileSketch back;
+    for (auto i = 0u; i < hits.size(); ++i)
+    {
+        whole.add(hits[i]);
+        (i % 3u ? front : back).add(hits[i]);
+    }
+    front.merge(back);
+    auto sameQuantiles = true;
+    for (auto q : quantiles)
+        sameQuantiles &= front.quantile(q) == whole.quantile(q);
+    check(front.count() == whole.count() && sameQuantiles, "merged sketches match a single one");
+
+    const auto buckets = thicknessCore::histogram(summary, 16u);
+    check(buckets.size() == 16u, "the histogram has the buckets asked for");
+    check(std::accumulate(buckets.begin(), buckets.end(), uint64_t{}) == summary.hitCount, "the histogram counts every hit");
+
+    const float allMisses[] = { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
+    const auto  empty       = thicknessCore::summarize(allMisses, 2u);
+    check(empty.hitCount == 0u && empty.missCount == 2u, "all misses are only counted");
+    check(empty.min == 0.0f && empty.max == 0.0f && empty.sketch.quantile(0.5f) == 0.0f, "a summary with no hits is zero");
+
+    if (failures)
+        return 1;
+
+    std::printf("statsTest passed\n");
+    return 0;
+}
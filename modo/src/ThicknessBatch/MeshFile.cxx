@@ -0,0 +1,653 @@
+#include "MeshFile.hxx"
+
+#include <util/Parallel.hxx>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace batch
+{
+    namespace
+    {
+        using thicknessCore::Vec3;
+
+        // Faces as loaded, before they're turned into rays and triangles.
+        struct PolySoup
+        {
+            std::vector<Vec3>     positions;
+            std::vector<uint32_t> offsets{ 0u };  // Face count + 1 offsets into indices
+            std::vector<uint32_t> indices;
+        };
+
+        bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        const char* skipSpaces(const char* cur, const char* end)
+        {
+            while (cur < end && isSpace(*cur))
+                ++cur;
+            return cur;
+        }
+
+        const char* skipLine(const char* cur, const char* end)
+        {
+            while (cur < end && *cur != '\n')
+                ++cur;
+            return cur < end ? cur + 1 : end;
+        }
+
+        // from_chars doesn't take a leading plus, which some exporters write.
+        template <typename T>
+        bool parseNumber(const char*& cur, const char* end, T& value)
+        {
+            cur = skipSpaces(cur, end);
+            if (cur < end && *cur == '+')
+                ++cur;
+
+            const auto result = std::from_chars(cur, end, value);
+            if (result.ec != std::errc())
+                return false;
+
+            cur = result.ptr;
+            return true;
+        }
+
+        bool parseObj(const char* cur, const char* end, PolySoup& soup, std::string& error)
+        {
+            uint32_t line = 0u;
+            for (; cur < end; cur = skipLine(cur, end))
+            {
+                ++line;
+                cur = skipSpaces(cur, end);
+                if (end - cur < 2 || !isSpace(cur[1]))
+                    continue;
+
+                if (cur[0] == 'v')
+                {
+                    cur += 2;
+                    Vec3 p;
+                    if (!parseNumber(cur, end, p[0]) || !parseNumber(cur, end, p[1]) || !parseNumber(cur, end, p[2]))
+                    {
+                        error = "bad vertex on line " + std::to_string(line);
+                        return false;
+                    }
+                    soup.positions.push_back(p);
+                }
+                else if (cur[0] == 'f')
+                {
+                    cur += 2;
+
+                    // Each corner is v, v/vt, v//vn or v/vt/vn, we only need the v.
+                    const auto first = soup.indices.size();
+                    for (cur = skipSpaces(cur, end); cur < end && *cur != '\n'; cur = skipSpaces(cur, end))
+                    {
+                        int64_t index{};
+                        if (!parseNumber(cur, end, index) || index == 0)
+                        {
+                            error = "bad face on line " + std::to_string(line);
+                            return false;
+                        }
+
+                        // Negative indices count back from the latest vertex.
+                        index = index < 0 ? static_cast<int64_t>(soup.positions.size()) + index : index - 1;
+                        if (index < 0)
+                        {
+                            error = "face before its vertices on line " + std::to_string(line);
+                            return false;
+                        }
+                        soup.indices.push_back(static_cast<uint32_t>(index));
+
+                        while (cur < end && !isSpace(*cur) && *cur != '\n')
+                            ++cur;
+                    }
+
+                    if (soup.indices.size() - first < 3u)
+                        soup.indices.resize(first);
+                    else
+                        soup.offsets.push_back(static_cast<uint32_t>(soup.indices.size()));
+                }
+            }
+            return true;
+        }
+
+        // PLY is a header describing a list of elements, followed by their data in ascii
+        // or either byte order of binary.  We only want the vertex positions and face
+        // indices, but every property still has to be read to get past it.
+        enum class PlyType
+        {
+            int8,
+            uint8,
+            int16,
+            uint16,
+            int32,
+            uint32,
+            float32,
+            float64,
+            invalid
+        };
+
+        PlyType plyType(const std::string& name)
+        {
+            static const std::pair<const char*, PlyType> types[] = {
+                { "char", PlyType::int8 },     { "int8", PlyType::int8 },       { "uchar", PlyType::uint8 },    { "uint8", PlyType::uint8 },
+                { "short", PlyType::int16 },   { "int16", PlyType::int16 },     { "ushort", PlyType::uint16 },  { "uint16", PlyType::uint16 },
+                { "int", PlyType::int32 },     { "int32", PlyType::int32 },     { "uint", PlyType::uint32 },    { "uint32", PlyType::uint32 },
+                { "float", PlyType::float32 }, { "float32", PlyType::float32 }, { "double", PlyType::float64 }, { "float64", PlyType::float64 },
+            };
+
+            for (const auto& [typeName, type] : types)
+                if (name == typeName)
+                    return type;
+            return PlyType::invalid;
+        }
+
+        size_t plySize(PlyType type)
+        {
+            switch (type)
+            {
+                case PlyType::int8:
+                case PlyType::uint8:
+                    return 1u;
+                case PlyType::int16:
+                case PlyType::uint16:
+                    return 2u;
+                case PlyType::float64:
+                    return 8u;
+                default:
+                    return 4u;
+            }
+        }
+
+        struct PlyProperty
+        {
+            std::string name;
+            PlyType     type{ PlyType::invalid };
+            PlyType     countType{ PlyType::invalid };  // Set for lists
+
+            bool isList() const
+            {
+                return countType != PlyType::invalid;
+            }
+        };
+
+        struct PlyElement
+        {
+            std::string              name;
+            uint64_t                 count{};
+            std::vector<PlyProperty> properties;
+        };
+
+        enum class PlyFormat
+        {
+            ascii,
+            littleEndian,
+            bigEndian
+        };
+
+        class PlyReader
+        {
+        public:
+            PlyReader(const char* cur, const char* end, PlyFormat format) : m_cur(cur), m_end(end), m_format(format)
+            {
+                const uint16_t probe = 1u;
+                uint8_t        firstByte;
+                std::memcpy(&firstByte, &probe, 1u);
+                m_swap = format == (firstByte ? PlyFormat::bigEndian : PlyFormat::littleEndian);
+            }
+
+            bool ok() const
+            {
+                return !m_failed;
+            }
+
+            double read(PlyType type)
+            {
+                if (m_format == PlyFormat::ascii)
+                {
+                    double value{};
+                    if (!parseNumber(m_cur, m_end, value))
+                        m_failed = true;
+
+                    // Values can wrap onto new lines, so treat them as whitespace too.
+                    while (m_cur < m_end && (isSpace(*m_cur) || *m_cur == '\n'))
+                        ++m_cur;
+                    return value;
+                }
+
+                const auto size = plySize(type);
+                if (static_cast<size_t>(m_end - m_cur) < size)
+                {
+                    m_failed = true;
+                    return 0.0;
+                }
+
+                unsigned char bytes[8];
+                std::memcpy(bytes, m_cur, size);
+                m_cur += size;
+                if (m_swap)
+                    std::reverse(bytes, bytes + size);
+
+                switch (type)
+                {
+                    case PlyType::int8:
+                        return static_cast<double>(static_cast<int8_t>(bytes[0]));
+                    case PlyType::uint8:
+                        return static_cast<double>(bytes[0]);
+                    case PlyType::int16:
+                        return static_cast<double>(load<int16_t>(bytes));
+                    case PlyType::uint16:
+                        return static_cast<double>(load<uint16_t>(bytes));
+                    case PlyType::int32:
+                        return static_cast<double>(load<int32_t>(bytes));
+                    case PlyType::uint32:
+                        return static_cast<double>(load<uint32_t>(bytes));
+                    case PlyType::float32:
+                        return static_cast<double>(load<float>(bytes));
+                    case PlyType::float64:
+                        return load<double>(bytes);
+                    default:
+                        m_failed = true;
+                        return 0.0;
+                }
+            }
+
+        private:
+            template <typename T>
+            static T load(const unsigned char* bytes)
+            {
+                T value;
+                std::memcpy(&value, bytes, sizeof(T));
+                return value;
+            }
+
+            const char* m_cur;
+            const char* m_end;
+            PlyFormat   m_format;
+            bool        m_swap{};
+            bool        m_failed{};
+        };
+
+        bool parsePly(const char* cur, const char* end, PolySoup& soup, std::string& error)
+        {
+            auto nextLine = [&]()
+            {
+                const char* lineEnd = cur;
+                while (lineEnd < end && *lineEnd != '\n')
+                    ++lineEnd;
+
+                std::string line(cur, lineEnd);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                cur = lineEnd < end ? lineEnd + 1 : end;
+                return line;
+            };
+
+            auto words = [](const std::string& line)
+            {
+                std::vector<std::string> out;
+                size_t                   pos = 0u;
+                while (pos < line.size())
+                {
+                    const auto start = line.find_first_not_of(" \t", pos);
+                    if (start == std::string::npos)
+                        break;
+                    const auto stop = line.find_first_of(" \t", start);
+                    out.push_back(line.substr(start, stop - start));
+                    pos = stop == std::string::npos ? line.size() : stop;
+                }
+                return out;
+            };
+
+            if (nextLine() != "ply")
+            {
+                error = "missing ply magic";
+                return false;
+            }
+
+            PlyFormat               format{};
+            bool                    hasFormat{};
+            std::vector<PlyElement> elements;
+            for (;;)
+            {
+                if (cur >= end)
+                {
+                    error = "header has no end_header";
+                    return false;
+                }
+
+                const auto tokens = words(nextLine());
+                if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info")
+                    continue;
+                if (tokens[0] == "end_header")
+                    break;
+
+                if (tokens[0] == "format" && tokens.size() >= 2u)
+                {
+                    hasFormat = true;
+                    if (tokens[1] == "ascii")
+                        format = PlyFormat::ascii;
+                    else if (tokens[1] == "binary_little_endian")
+                        format = PlyFormat::littleEndian;
+                    else if (tokens[1] == "binary_big_endian")
+                        format = PlyFormat::bigEndian;
+                    else
+                        hasFormat = false;
+                }
+                else if (tokens[0] == "element" && tokens.size() >= 3u)
+                {
+                    PlyElement element;
+                    element.name  = tokens[1];
+                    element.count = std::strtoull(tokens[2].c_str(), nullptr, 10);
+                    elements.push_back(element);
+                }
+                else if (tokens[0] == "property" && !elements.empty())
+                {
+                    PlyProperty property;
+                    if (tokens.size() >= 5u && tokens[1] == "list")
+                    {
+                        property.countType = plyType(tokens[2]);
+                        property.type      = plyType(tokens[3]);
+                        property.name      = tokens[4];
+                        if (property.countType == PlyType::invalid)
+                            property.type = PlyType::invalid;
+                    }
+                    else if (tokens.size() >= 3u)
+                    {
+                        property.type = plyType(tokens[1]);
+                        property.name = tokens[2];
+                    }
+
+                    if (property.type == PlyType::invalid)
+                    {
+                        error = "unsupported property '" + property.name + "'";
+                        return false;
+                    }
+                    elements.back().properties.push_back(property);
+                }
+            }
+
+            if (!hasFormat)
+            {
+                error = "missing or unknown format";
+                return false;
+            }
+
+            PlyReader reader(cur, end, format);
+            for (const auto& element : elements)
+            {
+                const bool isVertex = element.name == "vertex";
+                const bool isFace   = element.name == "face";
+
+                if (isVertex)
+                    soup.positions.reserve(element.count);
+                if (isFace)
+                    soup.offsets.reserve(element.count + 1u);
+
+                for (auto i = 0ull; i < element.count && reader.ok(); ++i)
+                {
+                    Vec3 p{};
+                    for (const auto& property : element.properties)
+                    {
+                        if (!property.isList())
+                        {
+                            const auto value = reader.read(property.type);
+                            if (isVertex && property.name.size() == 1u && property.name[0] >= 'x' && property.name[0] <= 'z')
+                                p[property.name[0] - 'x'] = static_cast<float>(value);
+                            continue;
+                        }
+
+                        const auto count   = static_cast<uint64_t>(reader.read(property.countType));
+                        const bool indices = isFace && (property.name == "vertex_indices" || property.name == "vertex_index");
+                        for (auto k = 0ull; k < count && reader.ok(); ++k)
+                        {
+                            const auto value = reader.read(property.type);
+                            if (indices)
+                                soup.indices.push_back(static_cast<uint32_t>(value));
+                        }
+
+                        if (indices)
+                        {
+                            if (count < 3u)
+                                soup.indices.resize(soup.offsets.back());
+                            else
+                                soup.offsets.push_back(static_cast<uint32_t>(soup.indices.size()));
+                        }
+                    }
+
+                    if (isVertex)
+                        soup.positions.push_back(p);
+                }
+
+                if (!reader.ok())
+                {
+                    error = "data ends early in element '" + element.name + "'";
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Turns the faces into the engine's snapshot: one ray per poly and a fan of
+        // triangles, the same way the plugin triangulates.
+        void buildInput(PolySoup& soup, thicknessCore::MeshInput& mesh)
+        {
+            const auto polyCount = static_cast<uint32_t>(soup.offsets.size() - 1u);
+
+            mesh.clear();
+            mesh.polyIds.resize(polyCount);
+            mesh.rays.resize(polyCount);
+            mesh.triOffsets.resize(polyCount + 1u);
+
+            mesh.triOffsets[0] = 0u;
+            for (auto i = 0u; i < polyCount; ++i)
+                mesh.triOffsets[i + 1u] = mesh.triOffsets[i] + (soup.offsets[i + 1u] - soup.offsets[i] - 2u);
+            mesh.tris.resize(mesh.triOffsets[polyCount]);
+
+            static constexpr uint32_t grain = 4096u;
+            parallel::forEach(polyCount,
+                              grain,
+                              [&](uint32_t i)
+                              {
+                                  const auto* corners = &soup.indices[soup.offsets[i]];
+                                  const auto  count   = soup.offsets[i + 1u] - soup.offsets[i];
+
+                                  // Newell's method, which copes with non-planar polys.
+                                  double centre[3]{};
+                                  double normal[3]{};
+                                  for (auto c = 0u; c < count; ++c)
+                                  {
+                                      const auto& cur  = soup.positions[corners[c]];
+                                      const auto& next = soup.positions[corners[(c + 1u) % count]];
+                                      normal[0] += (static_cast<double>(cur[1]) - next[1]) * (static_cast<double>(cur[2]) + next[2]);
+                                      normal[1] += (static_cast<double>(cur[2]) - next[2]) * (static_cast<double>(cur[0]) + next[0]);
+                                      normal[2] += (static_cast<double>(cur[0]) - next[0]) * (static_cast<double>(cur[1]) + next[1]);
+                                      for (auto a = 0; a < 3; ++a)
+                                          centre[a] += cur[a];
+                                  }
+
+                                  const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+                                  auto& ray = mesh.rays[i];
+                                  for (auto a = 0; a < 3; ++a)
+                                  {
+                                      ray.origin[a] = static_cast<float>(centre[a] / count);
+                                      ray.dir[a]    = length > 0.0 ? static_cast<float>(-normal[a] / length) : 0.0f;
+                                  }
+                                  ray.ignorePoly = i;
+
+                                  // A degenerate poly has no direction to fire in, so it just misses.
+                                  if (!(length > 0.0))
+                                      ray.tMax = -1.0f;
+
+                                  mesh.polyIds[i] = i;
+
+                                  auto* tri = &mesh.tris[mesh.triOffsets[i]];
+                                  for (auto c = 2u; c < count; ++c, ++tri)
+                                  {
+                                      tri->v0   = soup.positions[corners[0]];
+                                      tri->v1   = soup.positions[corners[c - 1u]];
+                                      tri->v2   = soup.positions[corners[c]];
+                                      tri->poly = i;
+                                  }
+                              });
+
+            mesh.pointCount   = static_cast<uint32_t>(soup.positions.size());
+            mesh.pointOffsets = std::move(soup.offsets);
+            mesh.points       = std::move(soup.indices);
+        }
+
+        bool hasExtension(const std::string& path, const char* ext)
+        {
+            const auto extLen = std::strlen(ext);
+            if (path.size() < extLen)
+                return false;
+
+            for (auto i = 0u; i < extLen; ++i)
+            {
+                const char c = path[path.size() - extLen + i];
+                if (static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != ext[i])
+                    return false;
+            }
+            return true;
+        }
+    }  // namespace
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    bool MappedFile::open(const std::string& path, std::string& error)
+    {
+        close();
+
+#if defined(_WIN32)
+        // Plain reads here, the batch runs are on Linux boxes.
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            error = "can't open file";
+            return false;
+        }
+
+        m_size     = static_cast<size_t>(file.tellg());
+        auto* data = new char[m_size ? m_size : 1u];
+        file.seekg(0);
+        file.read(data, static_cast<std::streamsize>(m_size));
+        m_data = data;
+        return true;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            error = std::string("can't open file: ") + std::strerror(errno);
+            return false;
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            error = std::string("can't stat file: ") + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+
+        m_size = static_cast<size_t>(info.st_size);
+        if (m_size == 0u)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            error  = std::string("can't map file: ") + std::strerror(errno);
+            m_size = 0u;
+            return false;
+        }
+
+        // Both parsers go front to back.
+        ::madvise(data, m_size, MADV_SEQUENTIAL);
+
+        m_data   = static_cast<const char*>(data);
+        m_mapped = true;
+        return true;
+#endif
+    }
+
+    void MappedFile::close()
+    {
+#if defined(_WIN32)
+        delete[] m_data;
+#else
+        if (m_mapped)
+            ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+        m_data   = nullptr;
+        m_size   = 0u;
+        m_mapped = false;
+    }
+
+    const char* MappedFile::data() const
+    {
+        return m_data;
+    }
+
+    size_t MappedFile::size() const
+    {
+        return m_size;
+    }
+
+    bool loadMesh(const std::string& path, thicknessCore::MeshInput& mesh, std::string& error)
+    {
+        MappedFile file;
+        if (!file.open(path, error))
+            return false;
+
+        const char* begin = file.data();
+        const char* end   = begin + file.size();
+
+        PolySoup soup;
+        bool     parsed{};
+        if (hasExtension(path, ".obj"))
+            parsed = parseObj(begin, end, soup, error);
+        else if (hasExtension(path, ".ply"))
+            parsed = parsePly(begin, end, soup, error);
+        else
+            error = "unknown file type, expected .obj or .ply";
+
+        if (!parsed)
+            return false;
+
+        const auto pointCount = soup.positions.size();
+        for (auto index : soup.indices)
+        {
+            if (index >= pointCount)
+            {
+                error = "face uses vertex " + std::to_string(index + 1u) + " of " + std::to_string(pointCount);
+                return false;
+            }
+        }
+
+        buildInput(soup, mesh);
+        return true;
+    }
+}  // namespace batch
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Engine.hxx>
+
+#include <cstddef>
+#include <string>
+
+// Loading mesh files straight into engine snapshots, for running the thickness checks
+// without modo.  Errors come back as a message rather than an exception, since a bad
+// file shouldn't stop the rest of a batch.
+namespace batch
+{
+    // Read only view of a whole file.  It's memory mapped where the platform allows it, and
+    // read into memory otherwise.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& path, std::string& error);
+        void close();
+
+        const char* data() const;
+        size_t      size() const;
+
+    private:
+        const char* m_data{};
+        size_t      m_size{};
+        bool        m_mapped{};
+    };
+
+    // Loads an OBJ or PLY file, picked by the extension.  Each face becomes a poly with
+    // its ray fired from the centroid against the Newell normal, which is as close as we
+    // can get to modo's representative position and normal without the SDK.
+    bool loadMesh(const std::string& path, thicknessCore::MeshInput& mesh, std::string& error);
+}  // namespace batch
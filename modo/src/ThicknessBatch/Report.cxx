@@ -0,0 +1,139 @@
+#include "Report.hxx"
+
+#include <Engine.hxx>
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace batch
+{
+    namespace
+    {
+        // Closes on scope exit, and reports write errors that only show up on close.
+        class OutFile
+        {
+        public:
+            explicit OutFile(const std::string& path) : m_file(std::fopen(path.c_str(), "wb"))
+            {
+            }
+
+            ~OutFile()
+            {
+                if (m_file)
+                    std::fclose(m_file);
+            }
+
+            bool ok() const
+            {
+                return m_file && !m_failed;
+            }
+
+            void write(const void* data, size_t size)
+            {
+                if (m_file && size && std::fwrite(data, 1u, size, m_file) != size)
+                    m_failed = true;
+            }
+
+            bool close()
+            {
+                if (m_file && std::fclose(m_file) != 0)
+                    m_failed = true;
+                m_file = nullptr;
+                return !m_failed;
+            }
+
+        private:
+            std::FILE* m_file;
+            bool       m_failed{};
+        };
+
+        const char* className(uint8_t cls)
+        {
+            switch (cls)
+            {
+                case thicknessCore::overMax:
+                    return "over";
+                case thicknessCore::underMin:
+                    return "under";
+                default:
+                    return "ok";
+            }
+        }
+
+        void writeCsv(OutFile& file, const std::vector<float>& distances, const std::vector<uint8_t>& classes, bool classify)
+        {
+            // Rows go through a buffer, formatting is the slow part rather than the writes.
+            static constexpr size_t flushSize = 1u << 16u;
+
+            std::string buffer = classify ? "poly,thickness,class\n" : "poly,thickness\n";
+            buffer.reserve(flushSize + 64u);
+
+            char number[32];
+            for (auto i = 0u; i < distances.size(); ++i)
+            {
+                auto result = std::to_chars(number, number + sizeof(number), i);
+                buffer.append(number, result.ptr);
+                buffer.push_back(',');
+
+                if (distances[i] < std::numeric_limits<float>::infinity())
+                {
+                    result = std::to_chars(number, number + sizeof(number), distances[i]);
+                    buffer.append(number, result.ptr);
+                }
+
+                if (classify)
+                {
+                    buffer.push_back(',');
+                    buffer.append(className(classes[i]));
+                }
+                buffer.push_back('\n');
+
+                if (buffer.size() >= flushSize)
+                {
+                    file.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+            file.write(buffer.data(), buffer.size());
+        }
+
+        void writeBinary(OutFile& file, const std::vector<float>& distances, const std::vector<uint8_t>& classes, const ReportOptions& options)
+        {
+            const auto     polyCount = static_cast<uint32_t>(distances.size());
+            const uint32_t flags     = options.classify ? 1u : 0u;
+
+            file.write("THK1", 4u);
+            file.write(&polyCount, sizeof(polyCount));
+            file.write(&flags, sizeof(flags));
+            file.write(&options.min, sizeof(options.min));
+            file.write(&options.max, sizeof(options.max));
+            file.write(distances.data(), distances.size() * sizeof(float));
+            if (options.classify)
+                file.write(classes.data(), classes.size());
+        }
+    }  // namespace
+
+    bool writeReport(const std::string& path, const std::vector<float>& distances, const std::vector<uint8_t>& classes, const ReportOptions& options, std::string& error)
+    {
+        OutFile file(path);
+        if (!file.ok())
+        {
+            error = "can't open '" + path + "' for writing";
+            return false;
+        }
+
+        if (options.format == ReportFormat::binary)
+            writeBinary(file, distances, classes, options);
+        else
+            writeCsv(file, distances, classes, options.classify);
+
+        if (!file.close())
+        {
+            error = "failed writing '" + path + "'";
+            return false;
+        }
+        return true;
+    }
+}  // namespace batch
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per poly thickness reports.  The csv is one row per poly:
+//
+//     poly,thickness[,class]
+//
+// with an empty thickness for polys that hit nothing, and the class one of ok, over or
+// under when a range was given.  The binary report is, in the host's byte order:
+//
+//     char     magic[4]      "THK1"
+//     uint32_t polyCount
+//     uint32_t flags         bit 0 set when the classes follow the thicknesses
+//     float    min, max      the range the classes were worked out against
+//     float    thickness[polyCount]   infinity for polys that hit nothing
+//     uint8_t  class[polyCount]       thicknessCore::Classification, if flagged
+namespace batch
+{
+    enum class ReportFormat
+    {
+        csv,
+        binary
+    };
+
+    struct ReportOptions
+    {
+        ReportFormat format{ ReportFormat::csv };
+        bool         classify{};
+        float        min{};
+        float        max{};
+    };
+
+    // Classes are per poly, and only written when the options ask for them.
+    bool writeReport(const std::string& path, const std::vector<float>& distances, const std::vector<uint8_t>& classes, const ReportOptions& options, std::string& error);
+}  // namespace batch
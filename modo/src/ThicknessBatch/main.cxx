@@ -0,0 +1,306 @@
+// Headless version of the thickness checker, for running the checks over a pile of
+// assets without modo.  Each mesh file gets the same rays the plugin would fire, and
+// the per poly thickness goes into a report next to it, or in the output directory.
+//
+// Files are loaded and cast in parallel, one per core.  A single large file still
+// gets every core, since the engine's own loops only go wide when nothing above them has.
+
+#include "MeshFile.hxx"
+#include "Report.hxx"
+
+#include <Engine.hxx>
+
+#include <util/Parallel.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        std::vector<std::string> files;
+        std::string              outDir;
+        batch::ReportOptions     report;
+        thicknessCore::Sampling  sampling{ 1u, 0.2618f };  // 15 degree cone, same as the plugin
+        thicknessCore::Isa       isa{ thicknessCore::bestIsa() };
+        bool                     quiet{};
+    };
+
+    struct FileResult
+    {
+        bool        ok{};
+        std::string error;
+        std::string reportPath;
+        uint32_t    polyCount{};
+        uint32_t    rayCount{};
+        uint32_t    overCount{};
+        uint32_t    underCount{};
+        double      loadMs{};
+        double      castMs{};
+    };
+
+    void printUsage()
+    {
+        std::printf("usage: thicknessBatch [options] <mesh.obj|mesh.ply>...\n"
+                    "\n"
+                    "  -o, --out <dir>             Directory for the reports, next to each mesh by default\n"
+                    "  -f, --format <csv|bin>      Report format, csv by default\n"
+                    "      --samples <n>           Rays per poly, 1 by default\n"
+                    "      --cone <degrees>        Half angle of the sampling cone, 15 by default\n"
+                    "      --statistic <name>      minimum, mean or median of the samples, minimum by default\n"
+                    "      --min <dist>            Classify polys against a min and max thickness\n"
+                    "      --max <dist>\n"
+                    "      --isa <scalar|sse4|avx2>  Force the ray kernel, the best one the cpu has by default\n"
+                    "  -q, --quiet                 Only report errors\n");
+    }
+
+    bool parseFloat(const char* text, float& value)
+    {
+        char* end{};
+        value = std::strtof(text, &end);
+        return end != text && *end == '\0';
+    }
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        bool hasMin{};
+        bool hasMax{};
+        for (auto i = 1; i < argc; ++i)
+        {
+            const std::string arg   = argv[i];
+            auto              value = [&]() -> const char*
+            {
+                if (i + 1 >= argc)
+                {
+                    std::fprintf(stderr, "%s needs a value\n", arg.c_str());
+                    return nullptr;
+                }
+                return argv[++i];
+            };
+
+            if (arg == "-h" || arg == "--help")
+            {
+                printUsage();
+                std::exit(0);
+            }
+            else if (arg == "-q" || arg == "--quiet")
+                options.quiet = true;
+            else if (arg == "-o" || arg == "--out")
+            {
+                const char* dir = value();
+                if (!dir)
+                    return false;
+                options.outDir = dir;
+            }
+            else if (arg == "-f" || arg == "--format")
+            {
+                const char* format = value();
+                if (!format)
+                    return false;
+
+                if (std::strcmp(format, "csv") == 0)
+                    options.report.format = batch::ReportFormat::csv;
+                else if (std::strcmp(format, "bin") == 0)
+                    options.report.format = batch::ReportFormat::binary;
+                else
+                {
+                    std::fprintf(stderr, "unknown format '%s'\n", format);
+                    return false;
+                }
+            }
+            else if (arg == "--samples")
+            {
+                const char* count = value();
+                if (!count)
+                    return false;
+                options.sampling.rays = static_cast<uint32_t>(std::max(std::atoi(count), 1));
+            }
+            else if (arg == "--cone")
+            {
+                const char* degrees = value();
+                float       angle{};
+                if (!degrees || !parseFloat(degrees, angle))
+                    return false;
+                options.sampling.coneAngle = angle * 3.14159265f / 180.0f;
+            }
+            else if (arg == "--statistic")
+            {
+                const char* name = value();
+                if (!name)
+                    return false;
+
+                if (std::strcmp(name, "minimum") == 0)
+                    options.sampling.statistic = thicknessCore::Statistic::minimum;
+                else if (std::strcmp(name, "mean") == 0)
+                    options.sampling.statistic = thicknessCore::Statistic::mean;
+                else if (std::strcmp(name, "median") == 0)
+                    options.sampling.statistic = thicknessCore::Statistic::median;
+                else
+                {
+                    std::fprintf(stderr, "unknown statistic '%s'\n", name);
+                    return false;
+                }
+            }
+            else if (arg == "--min" || arg == "--max")
+            {
+                const char* dist = value();
+                float&      bound = arg == "--min" ? options.report.min : options.report.max;
+                if (!dist || !parseFloat(dist, bound))
+                    return false;
+                (arg == "--min" ? hasMin : hasMax) = true;
+            }
+            else if (arg == "--isa")
+            {
+                const char* name = value();
+                if (!name)
+                    return false;
+
+                bool found{};
+                for (auto isa : { thicknessCore::Isa::scalar, thicknessCore::Isa::sse4, thicknessCore::Isa::avx2 })
+                {
+                    if (std::strcmp(name, thicknessCore::isaName(isa)) == 0)
+                    {
+                        options.isa = isa;
+                        found       = true;
+                    }
+                }
+
+                if (!found || !thicknessCore::isaSupported(options.isa))
+                {
+                    std::fprintf(stderr, "isa '%s' isn't available on this cpu\n", name);
+                    return false;
+                }
+            }
+            else if (!arg.empty() && arg[0] == '-')
+            {
+                std::fprintf(stderr, "unknown option '%s'\n", arg.c_str());
+                return false;
+            }
+            else
+                options.files.push_back(arg);
+        }
+
+        // A missing bound leaves that side open.
+        options.report.classify = hasMin || hasMax;
+        if (options.report.classify && !hasMax)
+            options.report.max = std::numeric_limits<float>::infinity();
+
+        if (options.files.empty())
+        {
+            printUsage();
+            return false;
+        }
+        return true;
+    }
+
+    std::string reportPath(const Options& options, const std::string& meshPath)
+    {
+        std::filesystem::path path(meshPath);
+        std::filesystem::path dir = options.outDir.empty() ? path.parent_path() : std::filesystem::path(options.outDir);
+
+        const char* ext = options.report.format == batch::ReportFormat::binary ? ".thickness.bin" : ".thickness.csv";
+        // The whole file name is kept, so model.obj and model.ply don't overwrite each other.
+        return (dir / path.filename()).string() + ext;
+    }
+
+    void processFile(const Options& options, const std::string& path, FileResult& result)
+    {
+        using clock = std::chrono::steady_clock;
+
+        const auto start = clock::now();
+
+        thicknessCore::MeshInput mesh;
+        if (!batch::loadMesh(path, mesh, result.error))
+            return;
+
+        const auto loaded = clock::now();
+
+        thicknessCore::Evaluator engine;
+        engine.setIsa(options.isa);
+        engine.evaluate(std::move(mesh), options.sampling, false);
+
+        const auto cast = clock::now();
+
+        const auto&          distances = engine.distances();
+        std::vector<uint8_t> classes;
+        if (options.report.classify)
+        {
+            classes.resize(distances.size());
+            thicknessCore::classify(distances.data(), static_cast<uint32_t>(distances.size()), options.report.min, options.report.max, classes.data());
+            for (auto cls : classes)
+            {
+                result.overCount += cls == thicknessCore::overMax;
+                result.underCount += cls == thicknessCore::underMin;
+            }
+        }
+
+        result.reportPath = reportPath(options, path);
+        if (!batch::writeReport(result.reportPath, distances, classes, options.report, result.error))
+            return;
+
+        result.ok        = true;
+        result.polyCount = static_cast<uint32_t>(distances.size());
+        result.rayCount  = engine.lastRayCount();
+        result.loadMs    = std::chrono::duration<double, std::milli>(loaded - start).count();
+        result.castMs    = std::chrono::duration<double, std::milli>(cast - loaded).count();
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+        return 2;
+
+    if (!options.outDir.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(options.outDir, ec);
+    }
+
+    const auto fileCount = static_cast<uint32_t>(options.files.size());
+
+    std::vector<FileResult> results(fileCount);
+    parallel::forEach(fileCount, 1u, [&](uint32_t i) { processFile(options, options.files[i], results[i]); });
+
+    // Printed afterwards, in the order given, so the log reads the same on every run.
+    int failed = 0;
+    for (auto i = 0u; i < fileCount; ++i)
+    {
+        const auto& file   = options.files[i];
+        const auto& result = results[i];
+        if (!result.ok)
+        {
+            std::fprintf(stderr, "%s: %s\n", file.c_str(), result.error.c_str());
+            ++failed;
+            continue;
+        }
+
+        if (options.quiet)
+            continue;
+
+        const double raysPerSec = result.castMs > 0.0 ? result.rayCount / (result.castMs * 1000.0) : 0.0;
+        std::printf("%s: %u polys, load %.1f ms, %u rays in %.1f ms (%.2f Mrays/s, %s)",
+                    file.c_str(),
+                    result.polyCount,
+                    result.loadMs,
+                    result.rayCount,
+                    result.castMs,
+                    raysPerSec,
+                    thicknessCore::isaName(options.isa));
+        if (options.report.classify)
+            std::printf(", %u over, %u under", result.overCount, result.underCount);
+        std::printf(" -> %s\n", result.reportPath.c_str());
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,510 @@
+#include "Bvh.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace thicknessCore
+{
+    namespace
+    {
+        // Build tuning.  Leaves stop splitting at a handful of triangles, and the
+        // depth limit keeps the fixed size traversal stack safe on degenerate input.
+        constexpr uint32_t binCount      = 16u;
+        constexpr uint32_t maxLeafSize   = blockWidth;
+        constexpr uint32_t maxDepth      = 60u;
+        constexpr float    traverseCost  = 1.0f;
+        constexpr float    intersectCost = 1.0f;
+
+        struct Bin
+        {
+            Aabb     bounds;
+            uint32_t count{};
+        };
+
+        Vec3 sub(const Vec3& a, const Vec3& b)
+        {
+            return { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+        }
+
+        uint32_t blocksFor(uint32_t count)
+        {
+            return (count + blockWidth - 1u) / blockWidth;
+        }
+
+        void writeLane(TriangleBlock& block, uint32_t lane, const Triangle* tri)
+        {
+            if (!tri)
+            {
+                for (auto a = 0; a < 3; ++a)
+                    block.v0[a][lane] = block.e1[a][lane] = block.e2[a][lane] = 0.0f;
+                block.poly[lane] = invalidIndex;
+                return;
+            }
+
+            const Vec3 e1 = sub(tri->v1, tri->v0);
+            const Vec3 e2 = sub(tri->v2, tri->v0);
+            for (auto a = 0; a < 3; ++a)
+            {
+                block.v0[a][lane] = tri->v0[a];
+                block.e1[a][lane] = e1[a];
+                block.e2[a][lane] = e2[a];
+            }
+            block.poly[lane] = tri->poly;
+        }
+
+        Aabb nodeBounds(const Bvh::Node& node)
+        {
+            return { node.boundsMin, node.boundsMax };
+        }
+    }  // namespace
+
+    void Aabb::add(const Vec3& p)
+    {
+        for (auto i = 0; i < 3; ++i)
+        {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        }
+    }
+
+    void Aabb::add(const Aabb& b)
+    {
+        for (auto i = 0; i < 3; ++i)
+        {
+            min[i] = std::min(min[i], b.min[i]);
+            max[i] = std::max(max[i], b.max[i]);
+        }
+    }
+
+    bool Aabb::empty() const
+    {
+        return min[0] > max[0];
+    }
+
+    float Aabb::area() const
+    {
+        if (empty())
+            return 0.0f;
+
+        const float dx = max[0] - min[0];
+        const float dy = max[1] - min[1];
+        const float dz = max[2] - min[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    float Aabb::intersect(const Vec3& origin, const Vec3& invDir, float tMin, float tMax) const
+    {
+        // Branch free, the comparisons are arranged so NaN from 0 * inf leaves the range alone.
+        for (auto i = 0; i < 3; ++i)
+        {
+            const float t0   = (min[i] - origin[i]) * invDir[i];
+            const float t1   = (max[i] - origin[i]) * invDir[i];
+            const float tLo  = t0 < t1 ? t0 : t1;
+            const float tHi  = t0 < t1 ? t1 : t0;
+            tMin             = tLo > tMin ? tLo : tMin;
+            tMax             = tHi < tMax ? tHi : tMax;
+        }
+        return tMin <= tMax ? tMin : std::numeric_limits<float>::infinity();
+    }
+
+    void Bvh::build(const std::vector<Triangle>& tris)
+    {
+        clear();
+        if (tris.empty())
+            return;
+
+        const auto triCount = static_cast<uint32_t>(tris.size());
+
+        std::vector<Aabb> triBounds(triCount);
+        std::vector<Vec3> centroids(triCount);
+        for (auto i = 0u; i < triCount; ++i)
+        {
+            triBounds[i].add(tris[i].v0);
+            triBounds[i].add(tris[i].v1);
+            triBounds[i].add(tris[i].v2);
+            for (auto a = 0; a < 3; ++a)
+                centroids[i][a] = (tris[i].v0[a] + tris[i].v1[a] + tris[i].v2[a]) / 3.0f;
+        }
+
+        std::vector<uint32_t> order(triCount);
+        std::iota(order.begin(), order.end(), 0u);
+
+        m_nodes.reserve(2u * triCount / maxLeafSize + 1u);
+        m_nodes.push_back({ {}, 0u, {}, triCount });
+
+        struct Task
+        {
+            uint32_t node;
+            uint32_t depth;
+        };
+        std::vector<Task> tasks{ { 0u, 0u } };
+
+        while (!tasks.empty())
+        {
+            const Task task = tasks.back();
+            tasks.pop_back();
+
+            const uint32_t first = m_nodes[task.node].first;
+            const uint32_t count = m_nodes[task.node].count;
+
+            Aabb bounds;
+            Aabb centroidBounds;
+            for (auto i = first; i < first + count; ++i)
+            {
+                bounds.add(triBounds[order[i]]);
+                centroidBounds.add(centroids[order[i]]);
+            }
+            m_nodes[task.node].boundsMin = bounds.min;
+            m_nodes[task.node].boundsMax = bounds.max;
+
+            if (count <= maxLeafSize || task.depth >= maxDepth)
+                continue;
+
+            // Find the cheapest split plane over the binned centroids of every axis.
+            float    bestCost  = std::numeric_limits<float>::max();
+            int      bestAxis  = -1;
+            uint32_t bestSplit = 0u;
+            for (auto axis = 0; axis < 3; ++axis)
+            {
+                const float lo     = centroidBounds.min[axis];
+                const float extent = centroidBounds.max[axis] - lo;
+                if (extent <= 0.0f)
+                    continue;
+
+                std::array<Bin, binCount> bins{};
+                const float               scale = binCount / extent;
+                for (auto i = first; i < first + count; ++i)
+                {
+                    const auto b = std::min(binCount - 1u, static_cast<uint32_t>((centroids[order[i]][axis] - lo) * scale));
+                    bins[b].count++;
+                    bins[b].bounds.add(triBounds[order[i]]);
+                }
+
+                // Sweep from both sides to get the area and count left/right of each plane.
+                std::array<float, binCount - 1>    leftArea{};
+                std::array<uint32_t, binCount - 1> leftCount{};
+                Aabb                               leftBox;
+                uint32_t                           leftSum = 0u;
+                for (auto b = 0u; b < binCount - 1u; ++b)
+                {
+                    leftSum += bins[b].count;
+                    leftBox.add(bins[b].bounds);
+                    leftCount[b] = leftSum;
+                    leftArea[b]  = leftBox.area();
+                }
+
+                Aabb     rightBox;
+                uint32_t rightSum = 0u;
+                for (auto b = binCount - 1u; b > 0u; --b)
+                {
+                    rightSum += bins[b].count;
+                    rightBox.add(bins[b].bounds);
+
+                    const auto  split = b - 1u;
+                    const float cost  = leftArea[split] * leftCount[split] + rightBox.area() * rightSum;
+                    if (leftCount[split] && rightSum && cost < bestCost)
+                    {
+                        bestCost  = cost;
+                        bestAxis  = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+
+            if (bestAxis < 0)
+                continue;
+
+            // Compare against just intersecting everything in a leaf.
+            const float parentArea = bounds.area();
+            const float splitCost  = traverseCost + intersectCost * (parentArea > 0.0f ? bestCost / parentArea : 0.0f);
+            if (splitCost >= intersectCost * count)
+                continue;
+
+            const float lo    = centroidBounds.min[bestAxis];
+            const float scale = binCount / (centroidBounds.max[bestAxis] - lo);
+            auto        mid   = std::partition(order.begin() + first,
+                                        order.begin() + first + count,
+                                        [&](uint32_t tri)
+                                        {
+                                            const auto b = std::min(binCount - 1u, static_cast<uint32_t>((centroids[tri][bestAxis] - lo) * scale));
+                                            return b <= bestSplit;
+                                        });
+
+            const auto leftCount = static_cast<uint32_t>(mid - (order.begin() + first));
+            if (leftCount == 0u || leftCount == count)
+                continue;
+
+            const auto left = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back({ {}, first, {}, leftCount });
+            m_nodes.push_back({ {}, first + leftCount, {}, count - leftCount });
+
+            m_nodes[task.node].first = left;
+            m_nodes[task.node].count = 0u;
+
+            tasks.push_back({ left + 1u, task.depth + 1u });
+            tasks.push_back({ left, task.depth + 1u });
+        }
+
+        m_nodes.shrink_to_fit();
+
+        // Lay every leaf out on its own run of blocks.  Padding lanes stay invalid.
+        for (auto& node : m_nodes)
+        {
+            if (!node.isLeaf())
+                continue;
+
+            const auto firstBlock = static_cast<uint32_t>(m_blocks.size());
+            const auto blockCount = blocksFor(node.count);
+            m_blocks.resize(firstBlock + blockCount);
+            m_order.resize(static_cast<size_t>(firstBlock + blockCount) * blockWidth, invalidIndex);
+
+            for (auto slot = 0u; slot < blockCount * blockWidth; ++slot)
+            {
+                const auto globalSlot = static_cast<size_t>(firstBlock) * blockWidth + slot;
+                if (slot < node.count)
+                    m_order[globalSlot] = order[node.first + slot];
+
+                const auto src = m_order[globalSlot];
+                writeLane(m_blocks[globalSlot / blockWidth], slot % blockWidth, src != invalidIndex ? &tris[src] : nullptr);
+            }
+            node.first = firstBlock;
+        }
+        m_triCount = triCount;
+    }
+
+    void Bvh::refit(const std::vector<Triangle>& tris)
+    {
+        if (tris.size() != m_triCount)
+        {
+            build(tris);
+            return;
+        }
+
+        for (auto slot = 0u; slot < m_order.size(); ++slot)
+        {
+            const auto src = m_order[slot];
+            if (src != invalidIndex)
+                writeLane(m_blocks[slot / blockWidth], slot % blockWidth, &tris[src]);
+        }
+
+        // Children always sit after their parent, so walking backwards sees them first.
+        for (auto n = m_nodes.size(); n-- > 0u;)
+        {
+            auto& node = m_nodes[n];
+            Aabb  bounds;
+            if (node.isLeaf())
+            {
+                const auto firstSlot = static_cast<size_t>(node.first) * blockWidth;
+                for (auto slot = firstSlot; slot < firstSlot + node.count; ++slot)
+                {
+                    const auto& src = tris[m_order[slot]];
+                    bounds.add(src.v0);
+                    bounds.add(src.v1);
+                    bounds.add(src.v2);
+                }
+            }
+            else
+            {
+                bounds = nodeBounds(m_nodes[node.first]);
+                bounds.add(nodeBounds(m_nodes[node.first + 1u]));
+            }
+            node.boundsMin = bounds.min;
+            node.boundsMax = bounds.max;
+        }
+    }
+
+    void Bvh::clear()
+    {
+        m_nodes.clear();
+        m_blocks.clear();
+        m_order.clear();
+        m_triCount = 0u;
+    }
+
+    bool Bvh::empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    uint32_t Bvh::triangleCount() const
+    {
+        return m_triCount;
+    }
+
+    const std::vector<Bvh::Node>& Bvh::nodes() const
+    {
+        return m_nodes;
+    }
+
+    void Bvh::setIsa(Isa isa)
+    {
+        m_isa       = isaSupported(isa) ? isa : bestIsa();
+        m_kernel    = blockKernel(m_isa);
+        m_packetBox = packetBoxKernel(m_isa);
+    }
+
+    Isa Bvh::isa() const
+    {
+        return m_isa;
+    }
+
+    bool Bvh::intersect(const Ray& ray, Hit& hit) const
+    {
+        hit = {};
+        if (m_nodes.empty())
+            return false;
+
+        const Vec3 invDir{ 1.0f / ray.dir[0], 1.0f / ray.dir[1], 1.0f / ray.dir[2] };
+
+        // Box misses come back as infinity, so the range is kept finite to tell them apart.
+        float closest = std::min(ray.tMax, std::numeric_limits<float>::max());
+        if (nodeBounds(m_nodes[0]).intersect(ray.origin, invDir, ray.tMin, closest) > closest)
+            return false;
+
+        struct StackEntry
+        {
+            uint32_t node;
+            float    dist;
+        };
+        std::array<StackEntry, maxDepth + 2u> stack;
+        uint32_t                              stackSize = 0u;
+        uint32_t                              nodeIdx   = 0u;
+
+        while (true)
+        {
+            const Node& node = m_nodes[nodeIdx];
+            if (node.isLeaf())
+            {
+                m_kernel(&m_blocks[node.first], blocksFor(node.count), ray, closest, hit.poly);
+            }
+            else
+            {
+                // Visit the nearer child first, and push the other if it's still in range.
+                uint32_t nearIdx = node.first;
+                uint32_t farIdx  = node.first + 1u;
+                float    tNear   = nodeBounds(m_nodes[nearIdx]).intersect(ray.origin, invDir, ray.tMin, closest);
+                float    tFar    = nodeBounds(m_nodes[farIdx]).intersect(ray.origin, invDir, ray.tMin, closest);
+                if (tFar < tNear)
+                {
+                    std::swap(nearIdx, farIdx);
+                    std::swap(tNear, tFar);
+                }
+
+                if (tNear <= closest)
+                {
+                    if (tFar <= closest)
+                        stack[stackSize++] = { farIdx, tFar };
+                    nodeIdx = nearIdx;
+                    continue;
+                }
+            }
+
+            // Pop until we find a node that can still beat the closest hit.
+            while (stackSize && stack[stackSize - 1u].dist > closest)
+                --stackSize;
+            if (stackSize == 0u)
+                break;
+            nodeIdx = stack[--stackSize].node;
+        }
+
+        if (hit.valid())
+            hit.dist = closest;
+        return hit.valid();
+    }
+
+    void Bvh::intersectPacket(const Ray* rays, uint32_t count, Hit* hits) const
+    {
+        count = std::min(count, packetWidth);
+        for (auto r = 0u; r < count; ++r)
+            hits[r] = {};
+
+        if (m_nodes.empty() || count == 0u)
+            return;
+
+        // Unused lanes get an empty range and never become active.
+        RayPacket packet;
+        for (auto r = 0u; r < packetWidth; ++r)
+        {
+            const auto& ray = rays[r < count ? r : 0u];
+            for (auto a = 0; a < 3; ++a)
+            {
+                packet.origin[a][r] = ray.origin[a];
+                packet.invDir[a][r] = 1.0f / ray.dir[a];
+            }
+            packet.tMin[r]    = r < count ? ray.tMin : 1.0f;
+            packet.closest[r] = r < count ? std::min(ray.tMax, std::numeric_limits<float>::max()) : 0.0f;
+        }
+
+        // Returns a bit per ray that still overlaps the node within its closest hit.
+        auto activeRays = [&](const Node& node, uint32_t mask, float& nearest)
+        { return m_packetBox(node.boundsMin.data(), node.boundsMax.data(), packet, mask, nearest); };
+
+        struct StackEntry
+        {
+            uint32_t node;
+            uint32_t mask;
+        };
+        std::array<StackEntry, maxDepth + 2u> stack;
+        uint32_t                              stackSize = 0u;
+
+        float    rootDist;
+        uint32_t mask    = activeRays(m_nodes[0], (1u << count) - 1u, rootDist);
+        uint32_t nodeIdx = 0u;
+
+        while (mask)
+        {
+            const Node& node = m_nodes[nodeIdx];
+            if (node.isLeaf())
+            {
+                for (auto r = 0u; r < count; ++r)
+                    if (mask & (1u << r))
+                        m_kernel(&m_blocks[node.first], blocksFor(node.count), rays[r], packet.closest[r], hits[r].poly);
+            }
+            else
+            {
+                // Children are ordered by the closest entry over the rays that reach them.
+                float      tNear;
+                float      tFar;
+                uint32_t   nearIdx  = node.first;
+                uint32_t   farIdx   = node.first + 1u;
+                uint32_t   nearMask = activeRays(m_nodes[nearIdx], mask, tNear);
+                uint32_t   farMask  = activeRays(m_nodes[farIdx], mask, tFar);
+                if (tFar < tNear)
+                {
+                    std::swap(nearIdx, farIdx);
+                    std::swap(nearMask, farMask);
+                }
+
+                if (nearMask)
+                {
+                    if (farMask)
+                        stack[stackSize++] = { farIdx, farMask };
+                    nodeIdx = nearIdx;
+                    mask    = nearMask;
+                    continue;
+                }
+                if (farMask)
+                {
+                    nodeIdx = farIdx;
+                    mask    = farMask;
+                    continue;
+                }
+            }
+
+            // Hits found since a node was pushed may have culled some of its rays.
+            mask = 0u;
+            while (stackSize && !mask)
+            {
+                const auto& entry = stack[--stackSize];
+                float       unused;
+                nodeIdx = entry.node;
+                mask    = activeRays(m_nodes[nodeIdx], entry.mask, unused);
+            }
+        }
+
+        for (auto r = 0u; r < count; ++r)
+            if (hits[r].valid())
+                hits[r].dist = packet.closest[r];
+    }
+}  // namespace thicknessCore
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Kernels.hxx"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// A bounding volume hierarchy over a triangle soup, used to fire the thickness rays.
+// Nothing in here touches the SDK, so the same code can be fed synthetic meshes
+// outside of modo for testing and benchmarking.
+namespace thicknessCore
+{
+    using Vec3 = std::array<float, 3>;
+
+    static constexpr uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+
+    // Input triangle.  The poly index is whatever the caller uses to identify the
+    // source polygon, and is handed back on a hit.
+    struct Triangle
+    {
+        Vec3     v0;
+        Vec3     v1;
+        Vec3     v2;
+        uint32_t poly;
+    };
+
+    struct Ray
+    {
+        Vec3     origin;
+        Vec3     dir;
+        float    tMin{ 0.0f };
+        float    tMax{ std::numeric_limits<float>::infinity() };
+        uint32_t ignorePoly{ invalidIndex };  // Triangles from this poly are never hit
+    };
+
+    struct Aabb
+    {
+        Vec3 min{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+        Vec3 max{ std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+        void  add(const Vec3& p);
+        void  add(const Aabb& b);
+        bool  empty() const;
+        float area() const;
+
+        // Slab test against the [tMin, tMax] part of a ray, returns the entry distance or
+        // infinity on a miss, so tMax should be finite.  Takes the inverse direction so
+        // callers can reuse it.
+        float intersect(const Vec3& origin, const Vec3& invDir, float tMin, float tMax) const;
+    };
+
+    struct Hit
+    {
+        float    dist{ std::numeric_limits<float>::infinity() };
+        uint32_t poly{ invalidIndex };
+
+        bool valid() const
+        {
+            return poly != invalidIndex;
+        }
+    };
+
+    class Bvh
+    {
+    public:
+        // Nodes are stored depth first in one flat array.  Interior nodes keep the
+        // index of their left child, and the right child always sits right after it.
+        // Leaves keep their first triangle block and a non-zero triangle count.
+        struct Node
+        {
+            Vec3     boundsMin;
+            uint32_t first;
+            Vec3     boundsMax;
+            uint32_t count;
+
+            bool isLeaf() const
+            {
+                return count != 0;
+            }
+        };
+
+        // Builds the tree using a binned surface area heuristic.
+        void build(const std::vector<Triangle>& tris);
+        void clear();
+
+        // Updates the triangle positions and node bounds in place, keeping the tree layout.
+        // The triangles must be the same ones, in the same order, that the tree was built
+        // from.  Much cheaper than a build, but the tree gets worse as things move further.
+        void refit(const std::vector<Triangle>& tris);
+
+        bool     empty() const;
+        uint32_t triangleCount() const;
+
+        const std::vector<Node>& nodes() const;
+
+        // Picks the leaf kernel, the best one the cpu supports is used by default.
+        void setIsa(Isa isa);
+        Isa  isa() const;
+
+        // Finds the closest hit along the ray, returns false if nothing was hit.
+        bool intersect(const Ray& ray, Hit& hit) const;
+
+        // Traces up to packetWidth rays through the tree together.  Rays from neighbouring
+        // polys tend to visit the same nodes, so each node is fetched once per packet rather
+        // than once per ray, and only the rays that still overlap a node are tested at its leaves.
+        static constexpr uint32_t packetWidth = blockWidth;
+        void                      intersectPacket(const Ray* rays, uint32_t count, Hit* hits) const;
+
+    private:
+        // Leaf triangles are packed into blocks for the kernels, each leaf starting on
+        // a fresh block.  The order maps every lane back to its input triangle.
+        std::vector<Node>          m_nodes;
+        std::vector<TriangleBlock> m_blocks;
+        std::vector<uint32_t>      m_order;
+        uint32_t                   m_triCount{};
+        Isa                        m_isa{ bestIsa() };
+        BlockKernel                m_kernel{ blockKernel(bestIsa()) };
+        PacketBoxKernel            m_packetBox{ packetBoxKernel(bestIsa()) };
+    };
+}  // namespace thicknessCore
@@ -0,0 +1,573 @@
+#include "Engine.hxx"
+
+#include <util/Parallel.hxx>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace thicknessCore
+{
+    namespace
+    {
+        // If more than this fraction of the polys changed, a full recast is cheaper
+        // than testing every cached ray against the changed region.
+        constexpr uint32_t fullRecastDivisor = 4u;
+        constexpr uint32_t grain             = 1024u;
+
+        uint64_t hashFloats(uint64_t hash, const float* values, size_t count)
+        {
+            // FNV-1a over the raw bits, positions either match exactly or the poly moved.
+            for (auto i = 0u; i < count; ++i)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &values[i], sizeof(bits));
+                hash = (hash ^ bits) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        uint64_t hashPoly(const MeshInput& mesh, uint32_t poly)
+        {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            hash          = hashFloats(hash, mesh.rays[poly].origin.data(), 3u);
+            hash          = hashFloats(hash, mesh.rays[poly].dir.data(), 3u);
+            for (auto t = mesh.triOffsets[poly]; t < mesh.triOffsets[poly + 1u]; ++t)
+            {
+                hash = hashFloats(hash, mesh.tris[t].v0.data(), 3u);
+                hash = hashFloats(hash, mesh.tris[t].v1.data(), 3u);
+                hash = hashFloats(hash, mesh.tris[t].v2.data(), 3u);
+            }
+            return hash;
+        }
+
+        Aabb polyBounds(const MeshInput& mesh, uint32_t poly)
+        {
+            Aabb bounds;
+            bounds.add(mesh.rays[poly].origin);
+            for (auto t = mesh.triOffsets[poly]; t < mesh.triOffsets[poly + 1u]; ++t)
+            {
+                bounds.add(mesh.tris[t].v0);
+                bounds.add(mesh.tris[t].v1);
+                bounds.add(mesh.tris[t].v2);
+            }
+            return bounds;
+        }
+
+        // The changed region is kept as a list of boxes plus their union, which rejects
+        // most rays with a single test when the edit is local.
+        struct Region
+        {
+            Aabb              bounds;
+            std::vector<Aabb> boxes;
+
+            void add(const Aabb& box)
+            {
+                if (box.empty())
+                    return;
+                bounds.add(box);
+                boxes.push_back(box);
+            }
+
+            // Quick rejection for every sample of a poly at once, all of them stay within
+            // reach of the shared origin.
+            bool within(const Vec3& origin, float reach) const
+            {
+                if (!(reach < std::numeric_limits<float>::max()))
+                    return !bounds.empty();
+
+                for (auto a = 0; a < 3; ++a)
+                    if (origin[a] + reach < bounds.min[a] || origin[a] - reach > bounds.max[a])
+                        return false;
+                return true;
+            }
+
+            bool touches(const Ray& ray, float dist) const
+            {
+                const Vec3  invDir{ 1.0f / ray.dir[0], 1.0f / ray.dir[1], 1.0f / ray.dir[2] };
+                const float tMax = dist < std::numeric_limits<float>::max() ? dist * 1.0001f + 1e-6f : std::numeric_limits<float>::max();
+                if (bounds.intersect(ray.origin, invDir, 0.0f, tMax) > tMax)
+                    return false;
+
+                for (const auto& box : boxes)
+                    if (box.intersect(ray.origin, invDir, 0.0f, tMax) <= tMax)
+                        return true;
+                return false;
+            }
+        };
+
+        // Splitmix64's finalizer, spreads the seed out for the jitter.
+        uint64_t mix(uint64_t x)
+        {
+            x = (x ^ (x >> 30u)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27u)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31u);
+        }
+
+        float unitFloat(uint64_t bits)
+        {
+            return static_cast<float>(bits >> 40u) * (1.0f / 16777216.0f);
+        }
+
+        // Casts the listed rays in packets and writes their distances.  Ray index r is sample
+        // r % sampling.rays of poly r / sampling.rays, and the samples of a poly share an
+        // origin and point roughly the same way, so they pack well.
+        void castSamples(const Bvh& bvh, const MeshInput& mesh, const Sampling& sampling, const uint32_t* indices, uint32_t count, float* samples)
+        {
+            Ray rayPacket[Bvh::packetWidth];
+            Hit hits[Bvh::packetWidth];
+            for (auto first = 0u; first < count; first += Bvh::packetWidth)
+            {
+                const auto width = std::min(Bvh::packetWidth, count - first);
+                for (auto r = 0u; r < width; ++r)
+                {
+                    const auto index = indices[first + r];
+                    rayPacket[r]     = sampleRay(mesh.rays[index / sampling.rays], index % sampling.rays, sampling);
+                }
+
+                bvh.intersectPacket(rayPacket, width, hits);
+                for (auto r = 0u; r < width; ++r)
+                    if (hits[r].valid())
+                        samples[indices[first + r]] = hits[r].dist;
+            }
+        }
+    }  // namespace
+
+    void classify(const float* distances, uint32_t count, float min, float max, uint8_t* classes)
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        for (auto i = 0u; i < count; ++i)
+        {
+            const float d     = distances[i];
+            const auto  over  = static_cast<uint8_t>((d > max) & (d < inf));
+            const auto  under = static_cast<uint8_t>((d < min) & (over ^ 1u));
+            classes[i]        = static_cast<uint8_t>(over | (under << 1u));
+        }
+    }
+
+    bool Sampling::operator==(const Sampling& other) const
+    {
+        if (rays != other.rays)
+            return false;
+
+        // With a single ray the cone and statistic make no difference.
+        return rays == 1u || (coneAngle == other.coneAngle && statistic == other.statistic);
+    }
+
+    bool Sampling::operator!=(const Sampling& other) const
+    {
+        return !(*this == other);
+    }
+
+    Ray sampleRay(const Ray& centre, uint32_t sample, const Sampling& sampling)
+    {
+        if (sampling.rays <= 1u)
+            return centre;
+
+        // Orthonormal basis around the centre ray, from Duff et al., "Building an
+        // Orthonormal Basis, Revisited", which has no special case to branch on.
+        const auto& n    = centre.dir;
+        const float sign = std::copysign(1.0f, n[2]);
+        const float a    = -1.0f / (sign + n[2]);
+        const float b    = n[0] * n[1] * a;
+        const Vec3  tangent{ 1.0f + sign * n[0] * n[0] * a, sign * b, -sign * n[0] };
+        const Vec3  bitangent{ b, sign + n[1] * n[1] * a, -n[1] };
+
+        uint64_t seed = hashFloats(0xcbf29ce484222325ull, centre.origin.data(), 3u);
+        seed          = mix(hashFloats(seed, centre.dir.data(), 3u) + sample * 0x9e3779b97f4a7c15ull);
+
+        // One ray per equal area ring of the cap, jittered within its ring, and spun round
+        // by the golden angle so neighbouring rings don't line up.
+        const float cosMax   = std::cos(sampling.coneAngle);
+        const float u        = (static_cast<float>(sample) + unitFloat(seed)) / static_cast<float>(sampling.rays);
+        const float cosTheta = 1.0f - u * (1.0f - cosMax);
+        const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        const float turn     = static_cast<float>(sample) * 0.618034f + unitFloat(mix(seed)) / static_cast<float>(sampling.rays);
+        const float phi      = 6.2831853f * (turn - std::floor(turn));
+        const float x        = sinTheta * std::cos(phi);
+        const float y        = sinTheta * std::sin(phi);
+
+        Ray ray = centre;
+        for (auto i = 0; i < 3; ++i)
+            ray.dir[i] = tangent[i] * x + bitangent[i] * y + n[i] * cosTheta;
+        return ray;
+    }
+
+    float reduceSamples(const float* samples, uint32_t count, Statistic statistic)
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+
+        std::array<float, maxSampleRays> hits;
+        uint32_t                         hitCount = 0u;
+        for (auto i = 0u; i < std::min(count, maxSampleRays); ++i)
+            if (samples[i] < inf)
+                hits[hitCount++] = samples[i];
+
+        if (hitCount == 0u)
+            return inf;
+
+        const auto end = hits.begin() + hitCount;
+        switch (statistic)
+        {
+            case Statistic::mean:
+            {
+                double sum = 0.0;
+                for (auto i = 0u; i < hitCount; ++i)
+                    sum += hits[i];
+                return static_cast<float>(sum / hitCount);
+            }
+            case Statistic::median:
+            {
+                const auto mid = hits.begin() + hitCount / 2u;
+                std::nth_element(hits.begin(), mid, end);
+                if (hitCount % 2u)
+                    return *mid;
+
+                // Even counts average the two middle values, the lower one is the largest
+                // of the half nth_element left below mid.
+                return 0.5f * (*mid + *std::max_element(hits.begin(), mid));
+            }
+            case Statistic::minimum:
+            default:
+                return *std::min_element(hits.begin(), end);
+        }
+    }
+
+    uint32_t MeshInput::polyCount() const
+    {
+        return static_cast<uint32_t>(rays.size());
+    }
+
+    void MeshInput::clear()
+    {
+        polyIds.clear();
+        rays.clear();
+        triOffsets.clear();
+        tris.clear();
+        pointOffsets.clear();
+        points.clear();
+        pointCount = 0u;
+    }
+
+    void Evaluator::reset()
+    {
+        m_mesh.clear();
+        m_polyHashes.clear();
+        m_samples.clear();
+        m_distances.clear();
+        m_bvh.clear();
+        m_pointPolyOffsets.clear();
+        m_pointPolys.clear();
+        m_pointDistances.clear();
+        m_summary      = Summary();
+        m_lastRayCount = 0u;
+    }
+
+    void Evaluator::setIsa(Isa isa)
+    {
+        m_bvh.setIsa(isa);
+    }
+
+    const std::vector<float>& Evaluator::distances() const
+    {
+        return m_distances;
+    }
+
+    const std::vector<float>& Evaluator::samples() const
+    {
+        return m_samples;
+    }
+
+    const Summary& Evaluator::summary() const
+    {
+        return m_summary;
+    }
+
+    const std::vector<float>& Evaluator::pointDistances() const
+    {
+        return m_pointDistances;
+    }
+
+    const MeshInput& Evaluator::mesh() const
+    {
+        return m_mesh;
+    }
+
+    uint32_t Evaluator::lastRayCount() const
+    {
+        return m_lastRayCount;
+    }
+
+    void Evaluator::castAll()
+    {
+        const auto rayCount = m_mesh.polyCount() * m_sampling.rays;
+
+        m_bvh.build(m_mesh.tris);
+        m_samples.assign(rayCount, std::numeric_limits<float>::infinity());
+        parallel::forChunks(rayCount,
+                            grain,
+                            [&](uint32_t, uint32_t begin, uint32_t end, uint32_t)
+                            {
+                                // Neighbouring rays make for coherent packets as they are.
+                                std::array<uint32_t, grain> indices;
+                                for (auto i = begin; i < end; ++i)
+                                    indices[i - begin] = i;
+                                castSamples(m_bvh, m_mesh, m_sampling, indices.data(), end - begin, m_samples.data());
+                            });
+
+        reduceAll();
+        m_lastRayCount = rayCount;
+    }
+
+    void Evaluator::reduceAll()
+    {
+        const auto polyCount = m_mesh.polyCount();
+        const auto rays      = m_sampling.rays;
+
+        if (rays == 1u)
+            m_distances = m_samples;
+        else
+        {
+            m_distances.resize(polyCount);
+            parallel::forEach(polyCount, grain, [&](uint32_t i) { m_distances[i] = reduceSamples(&m_samples[i * rays], rays, m_sampling.statistic); });
+        }
+
+        m_summary = summarize(m_distances.data(), polyCount);
+    }
+
+    void Evaluator::buildPointPolys()
+    {
+        const auto polyCount  = m_mesh.polyCount();
+        const auto pointCount = m_mesh.pointCount;
+
+        // Counting sort over every corner.  The counters are atomics rather than anything
+        // with a lock, and the slots they hand out are sorted per point afterwards, so the
+        // result doesn't depend on thread timing.
+        std::vector<std::atomic<uint32_t>> counts(pointCount);
+        parallel::forEach(polyCount,
+                          grain,
+                          [&](uint32_t poly)
+                          {
+                              for (auto c = m_mesh.pointOffsets[poly]; c < m_mesh.pointOffsets[poly + 1u]; ++c)
+                                  counts[m_mesh.points[c]].fetch_add(1u, std::memory_order_relaxed);
+                          });
+
+        m_pointPolyOffsets.resize(pointCount + 1u);
+        m_pointPolyOffsets[0] = 0u;
+        for (auto p = 0u; p < pointCount; ++p)
+        {
+            m_pointPolyOffsets[p + 1u] = m_pointPolyOffsets[p] + counts[p].load(std::memory_order_relaxed);
+            counts[p].store(m_pointPolyOffsets[p], std::memory_order_relaxed);
+        }
+
+        m_pointPolys.resize(m_pointPolyOffsets[pointCount]);
+        parallel::forEach(polyCount,
+                          grain,
+                          [&](uint32_t poly)
+                          {
+                              for (auto c = m_mesh.pointOffsets[poly]; c < m_mesh.pointOffsets[poly + 1u]; ++c)
+                                  m_pointPolys[counts[m_mesh.points[c]].fetch_add(1u, std::memory_order_relaxed)] = poly;
+                          });
+
+        parallel::forEach(pointCount, grain, [&](uint32_t p) { std::sort(&m_pointPolys[m_pointPolyOffsets[p]], &m_pointPolys[m_pointPolyOffsets[p + 1u]]); });
+    }
+
+    void Evaluator::splatPoints(bool sameTopology)
+    {
+        const auto pointCount = m_mesh.pointCount;
+        if (m_mesh.pointOffsets.size() != m_mesh.polyCount() + 1u)
+        {
+            m_pointDistances.clear();
+            m_pointPolyOffsets.clear();
+            m_pointPolys.clear();
+            return;
+        }
+
+        if (!sameTopology || m_pointPolyOffsets.size() != pointCount + 1u)
+            buildPointPolys();
+
+        // Every point gathers from its own polys, so the writes never overlap.
+        m_pointDistances.resize(pointCount);
+        parallel::forEach(pointCount,
+                          grain,
+                          [&](uint32_t p)
+                          {
+                              double   sum  = 0.0;
+                              uint32_t hits = 0u;
+                              for (auto k = m_pointPolyOffsets[p]; k < m_pointPolyOffsets[p + 1u]; ++k)
+                              {
+                                  const float dist = m_distances[m_pointPolys[k]];
+                                  if (dist < std::numeric_limits<float>::infinity())
+                                  {
+                                      sum += dist;
+                                      ++hits;
+                                  }
+                              }
+                              m_pointDistances[p] = hits ? static_cast<float>(sum / hits) : std::numeric_limits<float>::infinity();
+                          });
+    }
+
+    void Evaluator::evaluate(MeshInput&& mesh, const Sampling& sampling, bool incremental)
+    {
+        const auto polyCount = mesh.polyCount();
+
+        Sampling clamped = sampling;
+        clamped.rays     = std::min(std::max(sampling.rays, 1u), maxSampleRays);
+
+        const bool sameTopology = mesh.pointCount == m_mesh.pointCount && mesh.pointOffsets == m_mesh.pointOffsets && mesh.points == m_mesh.points;
+
+        std::vector<uint64_t> hashes(polyCount);
+        parallel::forEach(polyCount, grain, [&](uint32_t i) { hashes[i] = hashPoly(mesh, i); });
+
+        const bool hadPrevious = !m_distances.empty() || !m_mesh.rays.empty();
+        if (!incremental || !hadPrevious || clamped != m_sampling)
+        {
+            m_sampling   = clamped;
+            m_mesh       = std::move(mesh);
+            m_polyHashes = std::move(hashes);
+            castAll();
+            splatPoints(sameTopology);
+            return;
+        }
+
+        // Match the new polys to the old ones.  Plain point moves keep the poly order, so
+        // the map is only needed once the topology has changed.
+        const auto            oldCount  = m_mesh.polyCount();
+        const bool            sameOrder = mesh.polyIds == m_mesh.polyIds;
+        std::vector<uint32_t> previous(polyCount, invalidIndex);
+        std::vector<uint8_t>  oldMatched(oldCount, 0u);
+        if (sameOrder)
+        {
+            for (auto i = 0u; i < polyCount; ++i)
+                previous[i] = i;
+            std::fill(oldMatched.begin(), oldMatched.end(), 1u);
+        }
+        else
+        {
+            std::unordered_map<uint64_t, uint32_t> oldIndex;
+            oldIndex.reserve(oldCount);
+            for (auto i = 0u; i < oldCount; ++i)
+                oldIndex.emplace(m_mesh.polyIds[i], i);
+
+            for (auto i = 0u; i < polyCount; ++i)
+            {
+                auto it = oldIndex.find(mesh.polyIds[i]);
+                if (it != oldIndex.end())
+                {
+                    previous[i]            = it->second;
+                    oldMatched[it->second] = 1u;
+                }
+            }
+        }
+
+        // The region is everything a changed poly covered before or covers now, plus
+        // anything that was deleted.
+        Region   region;
+        uint32_t changedCount = 0u;
+        for (auto i = 0u; i < polyCount; ++i)
+        {
+            const auto prev = previous[i];
+            if (prev != invalidIndex && m_polyHashes[prev] == hashes[i])
+                continue;
+
+            ++changedCount;
+            region.add(polyBounds(mesh, i));
+            if (prev != invalidIndex)
+                region.add(polyBounds(m_mesh, prev));
+        }
+
+        for (auto i = 0u; i < oldCount; ++i)
+        {
+            if (oldMatched[i])
+                continue;
+
+            ++changedCount;
+            region.add(polyBounds(m_mesh, i));
+        }
+
+        if (changedCount * fullRecastDivisor > std::max(polyCount, 1u))
+        {
+            m_mesh       = std::move(mesh);
+            m_polyHashes = std::move(hashes);
+            castAll();
+            splatPoints(sameTopology);
+            return;
+        }
+
+        const auto         rays = m_sampling.rays;
+        std::vector<float> samples(polyCount * rays, std::numeric_limits<float>::infinity());
+        if (changedCount == 0u)
+        {
+            for (auto i = 0u; i < polyCount; ++i)
+                std::copy_n(&m_samples[previous[i] * rays], rays, &samples[i * rays]);
+
+            m_mesh         = std::move(mesh);
+            m_polyHashes   = std::move(hashes);
+            m_samples      = std::move(samples);
+            m_lastRayCount = 0u;
+            reduceAll();
+            splatPoints(sameTopology);
+            return;
+        }
+
+        // Points moving without a topology change can keep the tree layout.
+        if (sameOrder && mesh.triOffsets == m_mesh.triOffsets)
+            m_bvh.refit(mesh.tris);
+        else
+            m_bvh.build(mesh.tris);
+
+        std::atomic<uint32_t> rayCount{ 0u };
+        parallel::forChunks(polyCount,
+                            grain,
+                            [&](uint32_t, uint32_t begin, uint32_t end, uint32_t)
+                            {
+                                std::vector<uint32_t> recast;
+                                recast.reserve((end - begin) * rays);
+                                for (auto i = begin; i < end; ++i)
+                                {
+                                    const auto prev      = previous[i];
+                                    const bool unchanged = prev != invalidIndex && m_polyHashes[prev] == hashes[i];
+                                    if (unchanged && rays > 1u)
+                                    {
+                                        const auto* cached = &m_samples[prev * rays];
+                                        const float reach  = *std::max_element(cached, cached + rays) * 1.0001f + 1e-6f;
+                                        if (!region.within(mesh.rays[i].origin, reach))
+                                        {
+                                            std::copy_n(cached, rays, &samples[i * rays]);
+                                            continue;
+                                        }
+                                    }
+
+                                    for (auto s = 0u; s < rays; ++s)
+                                    {
+                                        const auto index = i * rays + s;
+                                        if (unchanged)
+                                        {
+                                            const auto cached = m_samples[prev * rays + s];
+                                            if (!region.touches(sampleRay(mesh.rays[i], s, m_sampling), cached))
+                                            {
+                                                samples[index] = cached;
+                                                continue;
+                                            }
+                                        }
+                                        recast.push_back(index);
+                                    }
+                                }
+
+                                const auto cast = static_cast<uint32_t>(recast.size());
+                                castSamples(m_bvh, mesh, m_sampling, recast.data(), cast, samples.data());
+                                rayCount += cast;
+                            });
+
+        m_mesh         = std::move(mesh);
+        m_polyHashes   = std::move(hashes);
+        m_samples      = std::move(samples);
+        m_lastRayCount = rayCount;
+        reduceAll();
+        splatPoints(sameTopology);
+    }
+}  // namespace thicknessCore
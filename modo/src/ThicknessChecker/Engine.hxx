@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Bvh.hxx"
+#include "Stats.hxx"
+
+#include <cstdint>
+#include <vector>
+
+// The engine owns the ray casting side of the thickness checker.  It's handed a
+// snapshot of the mesh on every evaluation and keeps enough from the previous one
+// to only recast the rays that a local edit could have changed.
+namespace thicknessCore
+{
+    // Flattened copy of the mesh.  Each poly has one centre ray along its inverted normal,
+    // with ignorePoly set to the poly's index, and a range of triangles in the flat triangle array.
+    struct MeshInput
+    {
+        std::vector<uint64_t> polyIds;     // Stable ids used to match polys between evaluations
+        std::vector<Ray>      rays;        // One per poly, dir must be normalized
+        std::vector<uint32_t> triOffsets;  // Poly count + 1 offsets into tris
+        std::vector<Triangle> tris;
+
+        // Optional, only needed for the per point distances.
+        std::vector<uint32_t> pointOffsets;  // Poly count + 1 offsets into points
+        std::vector<uint32_t> points;        // Point indices around each poly
+        uint32_t              pointCount{};
+
+        uint32_t polyCount() const;
+        void     clear();
+    };
+
+    // How the sample distances of a poly are reduced to its thickness.  Misses are left out,
+    // and a poly is only a miss if all of its rays are.
+    enum class Statistic : uint32_t
+    {
+        minimum,
+        mean,
+        median
+    };
+
+    static constexpr uint32_t maxSampleRays = 64u;
+
+    // With more than one ray, each poly fires rays spread over a cone around its centre ray.
+    // The cone is split into equal area rings with one jittered ray in each, which smooths
+    // out the noise a single ray gives on curved or non-planar polys.
+    struct Sampling
+    {
+        uint32_t  rays{ 1u };    // Per poly, from 1 to maxSampleRays
+        float     coneAngle{};   // Half angle of the cone, in radians
+        Statistic statistic{ Statistic::minimum };
+
+        bool operator==(const Sampling& other) const;
+        bool operator!=(const Sampling& other) const;
+    };
+
+    // Returns the given sample ray of a poly.  The jitter is seeded from the centre ray, so
+    // the same poly always gets the same rays, whatever its index or the session.  A single
+    // sample is always the centre ray itself.
+    Ray sampleRay(const Ray& centre, uint32_t sample, const Sampling& sampling);
+
+    // Reduces the sample distances of one poly, infinity if none of them hit.
+    float reduceSamples(const float* samples, uint32_t count, Statistic statistic);
+
+    // Thresholding against the user's min and max, see classify.
+    enum Classification : uint8_t
+    {
+        inRange  = 0u,
+        overMax  = 1u,
+        underMin = 2u
+    };
+
+    // Writes a Classification per distance.  Over the max wins if the range is inverted,
+    // and misses are never flagged.  There are no branches, so the loop vectorizes, which
+    // keeps scrubbing the thresholds cheap on heavy meshes.
+    void classify(const float* distances, uint32_t count, float min, float max, uint8_t* classes);
+
+    class Evaluator
+    {
+    public:
+        // Computes the thickness of every poly in the snapshot.  With incremental set and a
+        // previous snapshot around, polys are matched up by id and only rays that start on a
+        // changed poly, or pass through the region that changed, are recast.  Changing the
+        // sampling always recasts everything.
+        void evaluate(MeshInput&& mesh, const Sampling& sampling, bool incremental);
+        void reset();
+
+        // Picks the leaf kernel, handy for comparing them.  The best one the cpu supports is
+        // used by default.
+        void setIsa(Isa isa);
+
+        // Distances are per poly in snapshot order, and infinite where nothing was hit.
+        // The raw samples are per ray, sampling.rays to a poly.
+        const std::vector<float>& distances() const;
+        const std::vector<float>& samples() const;
+
+        // Each point gets the mean distance of the polys around it that hit something, and
+        // is infinite otherwise.  Empty if the snapshot didn't come with its points.
+        const std::vector<float>& pointDistances() const;
+
+        // Summary of the distances, worked out in the same evaluation.
+        const Summary& summary() const;
+        const MeshInput&          mesh() const;
+
+        // Number of rays cast by the last evaluate, handy for checking the incremental path.
+        uint32_t lastRayCount() const;
+
+    private:
+        void castAll();
+        void reduceAll();
+        void splatPoints(bool sameTopology);
+        void buildPointPolys();
+
+        MeshInput             m_mesh;
+        Sampling              m_sampling;
+        std::vector<uint64_t> m_polyHashes;
+        std::vector<float>    m_samples;
+        std::vector<float>    m_distances;
+        Summary               m_summary;
+        Bvh                   m_bvh;
+
+        // The polys around each point, the transpose of the snapshot's poly points.  Only
+        // rebuilt when the topology changes.
+        std::vector<uint32_t> m_pointPolyOffsets;
+        std::vector<uint32_t> m_pointPolys;
+        std::vector<float>    m_pointDistances;
+        uint32_t              m_lastRayCount{};
+    };
+}  // namespace thicknessCore
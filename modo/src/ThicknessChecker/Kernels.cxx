@@ -0,0 +1,382 @@
+#include "Kernels.hxx"
+
+#include "Bvh.hxx"
+
+#include <util/Simd.hxx>
+
+#include <cmath>
+#include <limits>
+
+namespace thicknessCore
+{
+    namespace
+    {
+        constexpr float detEpsilon = 1e-12f;
+
+        // Möller-Trumbore, double sided since scanned meshes rarely have consistent winding.
+        // The SIMD kernels below follow the exact same order of operations.
+        void blockScalar(const TriangleBlock* blocks, uint32_t blockCount, const Ray& ray, float& closest, uint32_t& poly)
+        {
+            const auto& o = ray.origin;
+            const auto& d = ray.dir;
+            for (auto b = 0u; b < blockCount; ++b)
+            {
+                const auto& blk = blocks[b];
+                for (auto l = 0u; l < blockWidth; ++l)
+                {
+                    if (blk.poly[l] == invalidIndex || blk.poly[l] == ray.ignorePoly)
+                        continue;
+
+                    const float e1x = blk.e1[0][l], e1y = blk.e1[1][l], e1z = blk.e1[2][l];
+                    const float e2x = blk.e2[0][l], e2y = blk.e2[1][l], e2z = blk.e2[2][l];
+
+                    const float px  = d[1] * e2z - d[2] * e2y;
+                    const float py  = d[2] * e2x - d[0] * e2z;
+                    const float pz  = d[0] * e2y - d[1] * e2x;
+                    const float det = e1x * px + e1y * py + e1z * pz;
+                    if (!(std::fabs(det) > detEpsilon))
+                        continue;
+
+                    const float inv = 1.0f / det;
+                    const float sx  = o[0] - blk.v0[0][l];
+                    const float sy  = o[1] - blk.v0[1][l];
+                    const float sz  = o[2] - blk.v0[2][l];
+                    const float u   = (sx * px + sy * py + sz * pz) * inv;
+
+                    const float qx = sy * e1z - sz * e1y;
+                    const float qy = sz * e1x - sx * e1z;
+                    const float qz = sx * e1y - sy * e1x;
+                    const float v  = (d[0] * qx + d[1] * qy + d[2] * qz) * inv;
+                    const float t  = (e2x * qx + e2y * qy + e2z * qz) * inv;
+
+                    if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > ray.tMin && t < closest)
+                    {
+                        closest = t;
+                        poly    = blk.poly[l];
+                    }
+                }
+            }
+        }
+
+        uint32_t packetBoxScalar(const float* boundsMin, const float* boundsMax, const RayPacket& packet, uint32_t mask, float& nearest)
+        {
+            uint32_t active = 0u;
+            nearest         = std::numeric_limits<float>::infinity();
+            for (auto r = 0u; r < blockWidth; ++r)
+            {
+                if (!((mask >> r) & 1u))
+                    continue;
+
+                float lo = packet.tMin[r];
+                float hi = packet.closest[r];
+                for (auto a = 0; a < 3; ++a)
+                {
+                    const float t0  = (boundsMin[a] - packet.origin[a][r]) * packet.invDir[a][r];
+                    const float t1  = (boundsMax[a] - packet.origin[a][r]) * packet.invDir[a][r];
+                    const float tLo = t0 < t1 ? t0 : t1;
+                    const float tHi = t0 < t1 ? t1 : t0;
+                    lo              = tLo > lo ? tLo : lo;
+                    hi              = tHi < hi ? tHi : hi;
+                }
+
+                if (lo <= hi)
+                {
+                    active |= 1u << r;
+                    nearest = std::min(nearest, lo);
+                }
+            }
+            return active;
+        }
+
+#ifdef SIMD_X86
+        SIMD_TARGET("sse4.1")
+        void testSse4(const TriangleBlock& blk, uint32_t lane, const Ray& ray, float& closest, uint32_t& poly)
+        {
+            const __m128 dx = _mm_set1_ps(ray.dir[0]);
+            const __m128 dy = _mm_set1_ps(ray.dir[1]);
+            const __m128 dz = _mm_set1_ps(ray.dir[2]);
+
+            const __m128 e1x = _mm_loadu_ps(&blk.e1[0][lane]);
+            const __m128 e1y = _mm_loadu_ps(&blk.e1[1][lane]);
+            const __m128 e1z = _mm_loadu_ps(&blk.e1[2][lane]);
+            const __m128 e2x = _mm_loadu_ps(&blk.e2[0][lane]);
+            const __m128 e2y = _mm_loadu_ps(&blk.e2[1][lane]);
+            const __m128 e2z = _mm_loadu_ps(&blk.e2[2][lane]);
+
+            const __m128 px  = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            const __m128 py  = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            const __m128 pz  = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+
+            const __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+            __m128       mask   = _mm_cmpgt_ps(absDet, _mm_set1_ps(detEpsilon));
+
+            const __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+            const __m128 sx  = _mm_sub_ps(_mm_set1_ps(ray.origin[0]), _mm_loadu_ps(&blk.v0[0][lane]));
+            const __m128 sy  = _mm_sub_ps(_mm_set1_ps(ray.origin[1]), _mm_loadu_ps(&blk.v0[1][lane]));
+            const __m128 sz  = _mm_sub_ps(_mm_set1_ps(ray.origin[2]), _mm_loadu_ps(&blk.v0[2][lane]));
+            const __m128 u   = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+
+            const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            const __m128 v  = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+            const __m128 t  = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+
+            const __m128 zero = _mm_setzero_ps();
+            mask              = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+            mask              = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+            mask              = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+            mask              = _mm_and_ps(mask, _mm_cmpgt_ps(t, _mm_set1_ps(ray.tMin)));
+            mask              = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(closest)));
+
+            const __m128i polys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&blk.poly[lane]));
+            const __m128i skip  = _mm_or_si128(_mm_cmpeq_epi32(polys, _mm_set1_epi32(static_cast<int>(invalidIndex))),
+                                              _mm_cmpeq_epi32(polys, _mm_set1_epi32(static_cast<int>(ray.ignorePoly))));
+            mask                = _mm_andnot_ps(_mm_castsi128_ps(skip), mask);
+
+            int bits = _mm_movemask_ps(mask);
+            if (!bits)
+                return;
+
+            // Reduce to the nearest lane, the earliest one wins on ties.
+            alignas(16) float dist[4];
+            _mm_store_ps(dist, _mm_blendv_ps(_mm_set1_ps(std::numeric_limits<float>::infinity()), t, mask));
+            for (auto l = 0u; l < 4u; ++l)
+            {
+                if ((bits & (1 << l)) && dist[l] < closest)
+                {
+                    closest = dist[l];
+                    poly    = blk.poly[lane + l];
+                }
+            }
+        }
+
+        SIMD_TARGET("sse4.1")
+        void blockSse4(const TriangleBlock* blocks, uint32_t blockCount, const Ray& ray, float& closest, uint32_t& poly)
+        {
+            for (auto b = 0u; b < blockCount; ++b)
+            {
+                testSse4(blocks[b], 0u, ray, closest, poly);
+                testSse4(blocks[b], 4u, ray, closest, poly);
+            }
+        }
+
+        SIMD_TARGET("avx2")
+        void blockAvx2(const TriangleBlock* blocks, uint32_t blockCount, const Ray& ray, float& closest, uint32_t& poly)
+        {
+            const __m256 dx = _mm256_set1_ps(ray.dir[0]);
+            const __m256 dy = _mm256_set1_ps(ray.dir[1]);
+            const __m256 dz = _mm256_set1_ps(ray.dir[2]);
+            const __m256 ox = _mm256_set1_ps(ray.origin[0]);
+            const __m256 oy = _mm256_set1_ps(ray.origin[1]);
+            const __m256 oz = _mm256_set1_ps(ray.origin[2]);
+
+            const __m256  zero    = _mm256_setzero_ps();
+            const __m256  one     = _mm256_set1_ps(1.0f);
+            const __m256  signBit = _mm256_set1_ps(-0.0f);
+            const __m256  eps     = _mm256_set1_ps(detEpsilon);
+            const __m256  tMin    = _mm256_set1_ps(ray.tMin);
+            const __m256i invalid = _mm256_set1_epi32(static_cast<int>(invalidIndex));
+            const __m256i ignore  = _mm256_set1_epi32(static_cast<int>(ray.ignorePoly));
+
+            for (auto b = 0u; b < blockCount; ++b)
+            {
+                const auto& blk = blocks[b];
+
+                const __m256 e1x = _mm256_loadu_ps(blk.e1[0]);
+                const __m256 e1y = _mm256_loadu_ps(blk.e1[1]);
+                const __m256 e1z = _mm256_loadu_ps(blk.e1[2]);
+                const __m256 e2x = _mm256_loadu_ps(blk.e2[0]);
+                const __m256 e2y = _mm256_loadu_ps(blk.e2[1]);
+                const __m256 e2z = _mm256_loadu_ps(blk.e2[2]);
+
+                const __m256 px  = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+                const __m256 py  = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+                const __m256 pz  = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+                const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+
+                __m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(signBit, det), eps, _CMP_GT_OQ);
+
+                const __m256 inv = _mm256_div_ps(one, det);
+                const __m256 sx  = _mm256_sub_ps(ox, _mm256_loadu_ps(blk.v0[0]));
+                const __m256 sy  = _mm256_sub_ps(oy, _mm256_loadu_ps(blk.v0[1]));
+                const __m256 sz  = _mm256_sub_ps(oz, _mm256_loadu_ps(blk.v0[2]));
+                const __m256 u   = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inv);
+
+                const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+                const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+                const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+                const __m256 v  = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inv);
+                const __m256 t  = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inv);
+
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, tMin, _CMP_GT_OQ));
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(closest), _CMP_LT_OQ));
+
+                const __m256i polys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blk.poly));
+                const __m256i skip  = _mm256_or_si256(_mm256_cmpeq_epi32(polys, invalid), _mm256_cmpeq_epi32(polys, ignore));
+                mask                = _mm256_andnot_ps(_mm256_castsi256_ps(skip), mask);
+
+                const int bits = _mm256_movemask_ps(mask);
+                if (!bits)
+                    continue;
+
+                alignas(32) float dist[blockWidth];
+                _mm256_store_ps(dist, _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), t, mask));
+                for (auto l = 0u; l < blockWidth; ++l)
+                {
+                    if ((bits & (1 << l)) && dist[l] < closest)
+                    {
+                        closest = dist[l];
+                        poly    = blk.poly[l];
+                    }
+                }
+            }
+        }
+
+        // The SIMD box tests use min(a, b) = a < b ? a : b, same as the scalar version, so
+        // NaN lanes from rays parallel to a slab behave the same way.
+        SIMD_TARGET("sse4.1")
+        uint32_t packetBoxHalfSse4(const float* boundsMin, const float* boundsMax, const RayPacket& packet, uint32_t lane, __m128& entry)
+        {
+            __m128 lo = _mm_loadu_ps(&packet.tMin[lane]);
+            __m128 hi = _mm_loadu_ps(&packet.closest[lane]);
+            for (auto a = 0; a < 3; ++a)
+            {
+                const __m128 org = _mm_loadu_ps(&packet.origin[a][lane]);
+                const __m128 inv = _mm_loadu_ps(&packet.invDir[a][lane]);
+                const __m128 t0  = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin[a]), org), inv);
+                const __m128 t1  = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax[a]), org), inv);
+                const __m128 lt  = _mm_cmplt_ps(t0, t1);
+                lo               = _mm_max_ps(_mm_blendv_ps(t1, t0, lt), lo);
+                hi               = _mm_min_ps(_mm_blendv_ps(t0, t1, lt), hi);
+            }
+            entry = lo;
+            return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(lo, hi)));
+        }
+
+        SIMD_TARGET("sse4.1")
+        uint32_t packetBoxSse4(const float* boundsMin, const float* boundsMax, const RayPacket& packet, uint32_t mask, float& nearest)
+        {
+            __m128         entryLo;
+            __m128         entryHi;
+            const uint32_t active = (packetBoxHalfSse4(boundsMin, boundsMax, packet, 0u, entryLo) | (packetBoxHalfSse4(boundsMin, boundsMax, packet, 4u, entryHi) << 4u)) & mask;
+
+            alignas(16) float entry[blockWidth];
+            _mm_store_ps(entry, entryLo);
+            _mm_store_ps(entry + 4, entryHi);
+
+            nearest = std::numeric_limits<float>::infinity();
+            for (auto r = 0u; r < blockWidth; ++r)
+                if ((active >> r) & 1u)
+                    nearest = std::min(nearest, entry[r]);
+            return active;
+        }
+
+        SIMD_TARGET("avx2")
+        uint32_t packetBoxAvx2(const float* boundsMin, const float* boundsMax, const RayPacket& packet, uint32_t mask, float& nearest)
+        {
+            __m256 lo = _mm256_load_ps(packet.tMin);
+            __m256 hi = _mm256_load_ps(packet.closest);
+            for (auto a = 0; a < 3; ++a)
+            {
+                const __m256 org = _mm256_load_ps(packet.origin[a]);
+                const __m256 inv = _mm256_load_ps(packet.invDir[a]);
+                const __m256 t0  = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMin[a]), org), inv);
+                const __m256 t1  = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMax[a]), org), inv);
+                const __m256 lt  = _mm256_cmp_ps(t0, t1, _CMP_LT_OQ);
+                lo               = _mm256_max_ps(_mm256_blendv_ps(t1, t0, lt), lo);
+                hi               = _mm256_min_ps(_mm256_blendv_ps(t0, t1, lt), hi);
+            }
+
+            const uint32_t active = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(lo, hi, _CMP_LE_OQ))) & mask;
+            if (!active)
+            {
+                nearest = std::numeric_limits<float>::infinity();
+                return 0u;
+            }
+
+            // Horizontal min over the active lanes.
+            const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            const __m256  keep     = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(active)), laneBits), laneBits));
+            __m256        m        = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), lo, keep);
+            __m128        h        = _mm_min_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+            h                      = _mm_min_ps(h, _mm_movehl_ps(h, h));
+            h                      = _mm_min_ss(h, _mm_shuffle_ps(h, h, 1));
+            nearest                = _mm_cvtss_f32(h);
+            return active;
+        }
+
+#endif
+    }  // namespace
+
+    const char* isaName(Isa isa)
+    {
+        switch (isa)
+        {
+            case Isa::sse4:
+                return "sse4";
+            case Isa::avx2:
+                return "avx2";
+            default:
+                return "scalar";
+        }
+    }
+
+    bool isaSupported(Isa isa)
+    {
+#ifdef SIMD_X86
+        switch (isa)
+        {
+            case Isa::sse4:
+                return simd::cpuFeatures().sse4;
+            case Isa::avx2:
+                return simd::cpuFeatures().avx2;
+            default:
+                return true;
+        }
+#else
+        return isa == Isa::scalar;
+#endif
+    }
+
+    Isa bestIsa()
+    {
+        if (isaSupported(Isa::avx2))
+            return Isa::avx2;
+        if (isaSupported(Isa::sse4))
+            return Isa::sse4;
+        return Isa::scalar;
+    }
+
+    PacketBoxKernel packetBoxKernel(Isa isa)
+    {
+        if (!isaSupported(isa))
+            isa = bestIsa();
+
+#ifdef SIMD_X86
+        if (isa == Isa::avx2)
+            return packetBoxAvx2;
+        if (isa == Isa::sse4)
+            return packetBoxSse4;
+#endif
+        return packetBoxScalar;
+    }
+
+    BlockKernel blockKernel(Isa isa)
+    {
+        if (!isaSupported(isa))
+            isa = bestIsa();
+
+#ifdef SIMD_X86
+        if (isa == Isa::avx2)
+            return blockAvx2;
+        if (isa == Isa::sse4)
+            return blockSse4;
+#endif
+        return blockScalar;
+    }
+}  // namespace thicknessCore
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+// Ray/triangle kernels used by the BVH leaves.  Triangles are stored eight to a block
+// in SoA layout, and each kernel tests one ray against a run of blocks.  The SSE4 and
+// AVX2 versions are compiled in alongside the scalar one and picked at runtime, so the
+// plugin still loads on machines without them.
+namespace thicknessCore
+{
+    struct Ray;
+
+    static constexpr uint32_t blockWidth = 8u;
+
+    // Each triangle is a vertex and two edges.  Unused lanes have an invalid poly and
+    // zero edges, so they can never report a hit.
+    struct alignas(32) TriangleBlock
+    {
+        float    v0[3][blockWidth];
+        float    e1[3][blockWidth];
+        float    e2[3][blockWidth];
+        uint32_t poly[blockWidth];
+    };
+
+    enum class Isa : uint32_t
+    {
+        scalar,
+        sse4,
+        avx2
+    };
+
+    const char* isaName(Isa isa);
+    bool        isaSupported(Isa isa);
+    Isa         bestIsa();
+
+    // Tests the ray against every lane of every block.  When a lane hits closer than
+    // closest, closest and poly are updated.  Ties go to the earliest lane, so every
+    // kernel reports the same poly for the same input.
+    using BlockKernel = void (*)(const TriangleBlock* blocks, uint32_t blockCount, const Ray& ray, float& closest, uint32_t& poly);
+
+    // Returns the kernel for the given instruction set, falling back to the best
+    // supported one if the cpu can't run it.
+    BlockKernel blockKernel(Isa isa);
+
+    // Up to eight rays in SoA form for packet traversal.  Unused lanes should have an
+    // empty [tMin, closest] range so they never report a box hit.
+    struct alignas(32) RayPacket
+    {
+        float origin[3][blockWidth];
+        float invDir[3][blockWidth];
+        float tMin[blockWidth];
+        float closest[blockWidth];
+    };
+
+    // Tests every lane of the packet against a box and returns a bit per lane in mask that
+    // still overlaps it, along with the nearest entry distance over those lanes.
+    using PacketBoxKernel = uint32_t (*)(const float* boundsMin, const float* boundsMax, const RayPacket& packet, uint32_t mask, float& nearest);
+
+    PacketBoxKernel packetBoxKernel(Isa isa);
+}  // namespace thicknessCore
@@ -0,0 +1,116 @@
+#include "PointBuffer.hxx"
+
+#include <cstring>
+
+namespace thicknessCore
+{
+    namespace
+    {
+        // FNV-1a, eight bytes at a time.  Results are written in a fixed order, so the same
+        // content always gives the same hash.
+        uint64_t hashBytes(const void* data, size_t size)
+        {
+            const auto* bytes = static_cast<const unsigned char*>(data);
+            uint64_t    hash  = 0xcbf29ce484222325ull;
+
+            size_t i = 0u;
+            for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+            {
+                uint64_t word;
+                std::memcpy(&word, bytes + i, sizeof(word));
+                hash = (hash ^ word) * 0x100000001b3ull;
+            }
+            for (; i < size; ++i)
+                hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+
+            return hash;
+        }
+    }  // namespace
+
+    FloatBuffer::FloatBuffer(std::vector<float>&& values)
+    {
+        if (values.empty())
+            return;
+
+        m_hash   = hashBytes(values.data(), values.size() * sizeof(float));
+        m_values = std::make_shared<const std::vector<float>>(std::move(values));
+    }
+
+    bool FloatBuffer::empty() const
+    {
+        return !m_values;
+    }
+
+    uint32_t FloatBuffer::size() const
+    {
+        return m_values ? static_cast<uint32_t>(m_values->size()) : 0u;
+    }
+
+    const float* FloatBuffer::data() const
+    {
+        return m_values ? m_values->data() : nullptr;
+    }
+
+    uint64_t FloatBuffer::hash() const
+    {
+        return m_hash;
+    }
+
+    bool FloatBuffer::operator==(const FloatBuffer& other) const
+    {
+        if (m_values == other.m_values)
+            return true;
+        return size() == other.size() && m_hash == other.m_hash;
+    }
+
+    bool FloatBuffer::operator!=(const FloatBuffer& other) const
+    {
+        return !(*this == other);
+    }
+
+    PointBuffer::PointBuffer(std::vector<float>&& x, std::vector<float>&& y, std::vector<float>&& z)
+        : m_x(std::move(x)), m_y(std::move(y)), m_z(std::move(z))
+    {
+    }
+
+    bool PointBuffer::empty() const
+    {
+        return m_x.empty();
+    }
+
+    uint32_t PointBuffer::size() const
+    {
+        return m_x.size();
+    }
+
+    const float* PointBuffer::x() const
+    {
+        return m_x.data();
+    }
+
+    const float* PointBuffer::y() const
+    {
+        return m_y.data();
+    }
+
+    const float* PointBuffer::z() const
+    {
+        return m_z.data();
+    }
+
+    uint64_t PointBuffer::hash() const
+    {
+        // The axis hashes folded in order, FNV style.
+        return ((m_x.hash() * 0x100000001b3ull) ^ m_y.hash()) * 0x100000001b3ull ^ m_z.hash();
+    }
+
+    bool PointBuffer::operator==(const PointBuffer& other) const
+    {
+        return m_x == other.m_x && m_y == other.m_y && m_z == other.m_z;
+    }
+
+    bool PointBuffer::operator!=(const PointBuffer& other) const
+    {
+        return !(*this == other);
+    }
+}  // namespace thicknessCore
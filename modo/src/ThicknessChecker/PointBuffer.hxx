@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace thicknessCore
+{
+    // An immutable list of floats.  Copies share the same storage, and the content hash is
+    // worked out once up front, so passing the cached results around the eval system and
+    // comparing them costs the same no matter how big they are.
+    class FloatBuffer
+    {
+    public:
+        FloatBuffer() = default;
+        explicit FloatBuffer(std::vector<float>&& values);
+
+        bool     empty() const;
+        uint32_t size() const;
+
+        // Stays valid for as long as any copy of the buffer is around.
+        const float* data() const;
+        uint64_t     hash() const;
+
+        float operator[](uint32_t i) const
+        {
+            return (*m_values)[i];
+        }
+
+        // Buffers sharing storage are equal without looking at them, otherwise it's down to
+        // the size and hash.
+        bool operator==(const FloatBuffer& other) const;
+        bool operator!=(const FloatBuffer& other) const;
+
+    private:
+        std::shared_ptr<const std::vector<float>> m_values;
+        uint64_t                                  m_hash{};
+    };
+
+    // An immutable list of points, shared and compared the same way.  Each axis is its own
+    // array, like partCore's Vec3Array, so passes over the points read them contiguously.
+    class PointBuffer
+    {
+    public:
+        PointBuffer() = default;
+
+        // The arrays must all be the same size.
+        PointBuffer(std::vector<float>&& x, std::vector<float>&& y, std::vector<float>&& z);
+
+        bool     empty() const;
+        uint32_t size() const;
+
+        // Stay valid for as long as any copy of the buffer is around.
+        const float* x() const;
+        const float* y() const;
+        const float* z() const;
+        uint64_t     hash() const;
+
+        bool operator==(const PointBuffer& other) const;
+        bool operator!=(const PointBuffer& other) const;
+
+    private:
+        FloatBuffer m_x;
+        FloatBuffer m_y;
+        FloatBuffer m_z;
+    };
+}  // namespace thicknessCore
@@ -0,0 +1,195 @@
+#include "Stats.hxx"
+
+#include <util/Parallel.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace thicknessCore
+{
+    namespace
+    {
+        // Anything smaller is treated as zero, the thinnest thing worth measuring is well
+        // above this and it keeps the bucket range bounded.
+        constexpr float minBucketValue = 1e-9f;
+    }  // namespace
+
+    QuantileSketch::QuantileSketch(float relativeAccuracy)
+    {
+        relativeAccuracy = std::min(std::max(relativeAccuracy, 1e-4f), 0.5f);
+        m_gamma          = (1.0f + relativeAccuracy) / (1.0f - relativeAccuracy);
+        m_logGamma       = std::log(m_gamma);
+    }
+
+    int32_t QuantileSketch::bucketIndex(float value) const
+    {
+        return static_cast<int32_t>(std::ceil(std::log(value) / m_logGamma));
+    }
+
+    float QuantileSketch::bucketValue(int32_t index) const
+    {
+        // Bucket i covers (gamma^(i-1), gamma^i], this is the value with the same relative
+        // error to either end.
+        return 2.0f * std::exp(index * m_logGamma) / (m_gamma + 1.0f);
+    }
+
+    void QuantileSketch::add(float value)
+    {
+        if (!(value > minBucketValue))
+        {
+            ++m_zeroCount;
+            return;
+        }
+
+        const auto index = bucketIndex(value);
+        if (m_counts.empty())
+        {
+            m_offset = index;
+            m_counts.push_back(0u);
+        }
+        else if (index < m_offset)
+        {
+            m_counts.insert(m_counts.begin(), static_cast<size_t>(m_offset - index), 0u);
+            m_offset = index;
+        }
+        else if (index >= m_offset + static_cast<int32_t>(m_counts.size()))
+            m_counts.resize(static_cast<size_t>(index - m_offset) + 1u, 0u);
+
+        ++m_counts[static_cast<size_t>(index - m_offset)];
+    }
+
+    void QuantileSketch::merge(const QuantileSketch& other)
+    {
+        m_zeroCount += other.m_zeroCount;
+        if (other.m_counts.empty())
+            return;
+
+        if (m_counts.empty())
+        {
+            m_offset = other.m_offset;
+            m_counts = other.m_counts;
+            return;
+        }
+
+        const auto first = std::min(m_offset, other.m_offset);
+        const auto last  = std::max(m_offset + static_cast<int32_t>(m_counts.size()), other.m_offset + static_cast<int32_t>(other.m_counts.size()));
+        if (first < m_offset)
+        {
+            m_counts.insert(m_counts.begin(), static_cast<size_t>(m_offset - first), 0u);
+            m_offset = first;
+        }
+        m_counts.resize(static_cast<size_t>(last - first), 0u);
+
+        for (auto i = 0u; i < other.m_counts.size(); ++i)
+            m_counts[static_cast<size_t>(other.m_offset - m_offset) + i] += other.m_counts[i];
+    }
+
+    uint64_t QuantileSketch::count() const
+    {
+        uint64_t total = m_zeroCount;
+        for (auto c : m_counts)
+            total += c;
+        return total;
+    }
+
+    float QuantileSketch::quantile(float q) const
+    {
+        const auto total = count();
+        if (total == 0u)
+            return 0.0f;
+
+        const auto rank = static_cast<uint64_t>(std::min(std::max(q, 0.0f), 1.0f) * static_cast<float>(total - 1u));
+        if (rank < m_zeroCount)
+            return 0.0f;
+
+        uint64_t seen = m_zeroCount;
+        for (auto i = 0u; i < m_counts.size(); ++i)
+        {
+            seen += m_counts[i];
+            if (seen > rank)
+                return bucketValue(m_offset + static_cast<int32_t>(i));
+        }
+        return bucketValue(m_offset + static_cast<int32_t>(m_counts.size()) - 1);
+    }
+
+    Summary summarize(const float* distances, uint32_t count)
+    {
+        static constexpr uint32_t grain = 16384u;
+
+        struct ChunkResult
+        {
+            Summary summary;
+            double  sum{};
+        };
+        std::vector<ChunkResult> results(parallel::chunkCount(count, grain));
+
+        parallel::forChunks(count,
+                            grain,
+                            [&](uint32_t chunk, uint32_t begin, uint32_t end, uint32_t)
+                            {
+                                auto& result = results[chunk];
+                                auto& s      = result.summary;
+                                s.min        = std::numeric_limits<float>::infinity();
+                                s.max        = -std::numeric_limits<float>::infinity();
+                                for (auto i = begin; i < end; ++i)
+                                {
+                                    const float d = distances[i];
+                                    if (!(d < std::numeric_limits<float>::infinity()))
+                                    {
+                                        ++s.missCount;
+                                        continue;
+                                    }
+
+                                    ++s.hitCount;
+                                    s.min = std::min(s.min, d);
+                                    s.max = std::max(s.max, d);
+                                    result.sum += d;
+                                    s.sketch.add(d);
+                                }
+                            });
+
+        // Merged in chunk order, so the mean comes out the same on every run.
+        Summary summary;
+        summary.min = std::numeric_limits<float>::infinity();
+        summary.max = -std::numeric_limits<float>::infinity();
+        double sum  = 0.0;
+        for (const auto& result : results)
+        {
+            const auto& s = result.summary;
+            summary.hitCount += s.hitCount;
+            summary.missCount += s.missCount;
+            if (s.hitCount)
+            {
+                summary.min = std::min(summary.min, s.min);
+                summary.max = std::max(summary.max, s.max);
+            }
+            sum += result.sum;
+            summary.sketch.merge(s.sketch);
+        }
+
+        if (summary.hitCount)
+            summary.mean = sum / static_cast<double>(summary.hitCount);
+        else
+            summary.min = summary.max = 0.0f;
+
+        return summary;
+    }
+
+    std::vector<uint64_t> histogram(const Summary& summary, uint32_t bucketCount)
+    {
+        std::vector<uint64_t> counts(std::max(bucketCount, 1u), 0u);
+        if (summary.hitCount == 0u)
+            return counts;
+
+        const float range = summary.max - summary.min;
+        summary.sketch.forEachBucket(
+            [&](float value, uint64_t count)
+            {
+                value       = std::min(std::max(value, summary.min), summary.max);
+                size_t slot = range > 0.0f ? static_cast<size_t>((value - summary.min) / range * counts.size()) : 0u;
+                counts[std::min(slot, counts.size() - 1u)] += count;
+            });
+        return counts;
+    }
+}  // namespace thicknessCore
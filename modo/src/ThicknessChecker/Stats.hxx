@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Whole mesh thickness summaries.  The distances are reduced chunk by chunk over every
+// core, and the chunk results merged, so nothing ever sorts or copies the full array.
+namespace thicknessCore
+{
+    // Log bucketed quantile sketch, after DDSketch.  Every value lands in a bucket whose
+    // width is a fixed fraction of its value, so any quantile it returns is within that
+    // relative accuracy of the true one, and two sketches merge by adding bucket counts.
+    class QuantileSketch
+    {
+    public:
+        explicit QuantileSketch(float relativeAccuracy = 0.01f);
+
+        void add(float value);
+        void merge(const QuantileSketch& other);
+
+        uint64_t count() const;
+
+        // q in [0, 1].  Zero if the sketch is empty.
+        float quantile(float q) const;
+
+        // Calls fn(value, count) for every non-empty bucket in increasing order, with the
+        // value each bucket stands for.
+        template <typename Fn>
+        void forEachBucket(Fn&& fn) const
+        {
+            if (m_zeroCount)
+                fn(0.0f, m_zeroCount);
+            for (auto i = 0u; i < m_counts.size(); ++i)
+                if (m_counts[i])
+                    fn(bucketValue(m_offset + static_cast<int32_t>(i)), m_counts[i]);
+        }
+
+    private:
+        int32_t bucketIndex(float value) const;
+        float   bucketValue(int32_t index) const;
+
+        float                 m_gamma;
+        float                 m_logGamma;
+        int32_t               m_offset{};     // Bucket index of m_counts[0]
+        std::vector<uint64_t> m_counts;
+        uint64_t              m_zeroCount{};  // Values too close to zero to bucket
+    };
+
+    struct Summary
+    {
+        uint64_t       hitCount{};
+        uint64_t       missCount{};
+        float          min{};
+        float          max{};
+        double         mean{};
+        QuantileSketch sketch;
+    };
+
+    // Summarizes the finite distances, misses are only counted.
+    Summary summarize(const float* distances, uint32_t count);
+
+    // Equal width buckets between the summary's min and max.  The counts come from the
+    // sketch rather than another pass over the distances, so values near a bucket edge
+    // can land one bucket over, within the sketch's accuracy.
+    std::vector<uint64_t> histogram(const Summary& summary, uint32_t bucketCount);
+}  // namespace thicknessCore
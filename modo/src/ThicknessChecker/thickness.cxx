@@ -5,26 +5,42 @@
 // projected thicknesses more than the max get a red dot, polys below the minimum
 // get a blue dot, and polys that hit nothing or fall within that range show no dots.
 
-// This is slow during mesh edits and would need quite a bit of work to become performant,
-// but it at least shows a few concepts for anyone interested and might be fun to play
-// with on less complex meshes.
+// Rays are cast against our own BVH over all cores, and in incremental mode only the
+// rays that a mesh edit could have affected are cast again, which keeps it usable
+// while editing fairly heavy meshes.  For curved or non-planar polys the item can fire
+// several rays per poly over a cone instead, and report their min, mean or median.
+// The item is a falloff too, weighting each point by how thin the polys around it are,
+// so deformers can thicken the thin areas without going through scripts, and it keeps a
+// whole mesh summary of the thickness with a histogram in its stats channel.
+
+#include "Engine.hxx"
+#include "PointBuffer.hxx"
+
+#include <util/IdTable.hxx>
+#include <util/Parallel.hxx>
 
 #include <lxsdk/lx_draw.hpp>
 #include <lxsdk/lx_force.hpp>
+#include <lxsdk/lx_deform.hpp>
 #include <lxsdk/lx_handles.hpp>
 #include <lxsdk/lx_item.hpp>
 #include <lxsdk/lx_plugin.hpp>
 #include <lxsdk/lx_thread.hpp>
+#include <lxsdk/lx_value.hpp>
 #include <lxsdk/lx_vmodel.hpp>
 #include <lxsdk/lxidef.h>
+#include <lxsdk/lxu_deform.hpp>
 #include <lxsdk/lxu_math.hpp>
 #include <lxsdk/lxu_modifier.hpp>
 #include <lxsdk/lxu_package.hpp>
 #include <lxsdk/lxu_schematic.hpp>
 #include <lxsdk/lxu_value.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -33,17 +49,28 @@
 namespace servers
 {
     static const std::string value    = "floatLists.value";
+    static const std::string hits     = "thick.hits.value";
+    static const std::string stats    = "thick.stats.value";
     static const std::string package  = "thick.maxMin";
+    static const std::string caster   = "thick.maxMin.cast";
     static const std::string modifier = "thick.maxMin.mod";
     static const std::string instance = "thick.maxMin.inst";
     static const std::string graph    = "thick.maxMin.graph";
+    static const std::string falloff  = "thick.maxMin.falloff";
 }  // namespace servers
 
 namespace channels
 {
-    static const std::string max      = "max";
-    static const std::string min      = "min";
-    static const std::string polylist = "polyList";
+    static const std::string max         = "max";
+    static const std::string min         = "min";
+    static const std::string incremental = "incremental";
+    static const std::string samples     = "samples";
+    static const std::string coneAngle   = "coneAngle";
+    static const std::string statistic   = "statistic";
+    static const std::string hits        = "hits";
+    static const std::string polylist    = "polyList";
+    static const std::string buckets     = "buckets";
+    static const std::string stats       = "stats";
 }  // namespace channels
 
 // The first part of the plugin is a custom value.  We're going to store
@@ -53,8 +80,6 @@ namespace channels
 // stale data or data that's in the middle of evaluation on another thread.
 namespace polyListData
 {
-    using vectorList = std::vector<std::array<double, 3>>;
-
     // Custom data types can be very simple.  We need to wrap our data
     // in a class that inherits from CLxValue and implement the copy and
     // compare functions, then register it with a metaRoot object (the pattern)
@@ -62,18 +87,20 @@ namespace polyListData
     class Value : public CLxValue
     {
     public:
-        // We store two vectors of poly positions. One is for polys
+        // We store two lists of poly positions. One is for polys
         // with a projected thickness over the max value the user sets
         // and the other is for thicknesses under the min value.
-        vectorList overMax;
-        vectorList underMin;
+        // The buffers are immutable and shared between copies, which
+        // matters once a heavy mesh has a few hundred thousand flagged polys.
+        thicknessCore::PointBuffer overMax;
+        thicknessCore::PointBuffer underMin;
 
-        // Copying a value just needs to copy our two vectors.
+        // Copying a value just shares the two buffers.
         void copy(const CLxValue* from) override;
 
         // Compare mostly just needs return a non-zero if the values are
         // different. In theory these can be sorted too, but that doesn't
-        // make a lot of sense for our two vectors.
+        // make a lot of sense for our two lists, so we only check the hashes.
         int compare(const CLxValue* from) override;
     };
 
@@ -113,12 +140,141 @@ namespace polyListData
     } root_meta;
 }  // namespace polyListData
 
+// The second custom value holds the raw result of the ray casts: the ray origin and hit
+// distance for every poly.  Only the ray casting modifier reads the mesh, and only the
+// thresholding modifier reads the min/max channels, so the eval system won't recast
+// anything while the user scrubs the thresholds, it just runs the cheap second pass.
+namespace hitData
+{
+    class Value : public CLxValue
+    {
+    public:
+        // The ray origin per poly, and the hit distance per poly (infinite for misses).
+        // Like the poly lists these are immutable and shared between copies, so copying
+        // and comparing the value doesn't depend on the size of the mesh.
+        thicknessCore::PointBuffer origins;
+        thicknessCore::FloatBuffer distances;
+
+        // The distances splatted to the mesh points.  These go out to every falloff the
+        // modifier creates as well.
+        thicknessCore::FloatBuffer pointDistances;
+
+        // Whole mesh summary of the distances, reduced during the same evaluation.  It
+        // follows from the distances, so compare doesn't need to look at it.
+        std::shared_ptr<const thicknessCore::Summary> summary;
+
+        void copy(const CLxValue* from) override;
+        int  compare(const CLxValue* from) override;
+    };
+
+    void Value::copy(const CLxValue* from)
+    {
+        const Value* v = dynamic_cast<const Value*>(from);
+
+        origins        = v->origins;
+        distances      = v->distances;
+        pointDistances = v->pointDistances;
+        summary        = v->summary;
+    }
+
+    int Value::compare(const CLxValue* from)
+    {
+        const Value* v = dynamic_cast<const Value*>(from);
+
+        if (distances != v->distances)
+            return -1;
+        else if (origins != v->origins || pointDistances != v->pointDistances)
+            return 1;
+
+        return 0;
+    }
+
+    static CLxMeta_Value<Value> val_meta(servers::hits.c_str());
+    static class CRoot : public CLxMetaRoot
+    {
+        bool pre_init() override
+        {
+            add(&val_meta);
+            return false;
+        }
+    } root_meta;
+}  // namespace hitData
+
+// The last custom value is a whole mesh summary for QA, so nobody has to go hunting
+// through dots to find out how a mesh did: hit and miss counts, the thickness range,
+// mean and a handful of percentiles, and a histogram over the range.
+namespace statsData
+{
+    static constexpr std::array<float, 7> percentiles{ 0.01f, 0.05f, 0.25f, 0.5f, 0.75f, 0.95f, 0.99f };
+
+    class Value : public CLxValue
+    {
+    public:
+        uint64_t hitCount{};
+        uint64_t missCount{};
+        float    min{};
+        float    max{};
+        double   mean{};
+
+        // Percentile values in the same order as percentiles, and equal width histogram
+        // buckets from min to max.  Both are within 1% of the exact values.
+        std::array<float, percentiles.size()> percentileValues{};
+        std::vector<uint64_t>                 histogram;
+
+        void copy(const CLxValue* from) override;
+        int  compare(const CLxValue* from) override;
+    };
+
+    void Value::copy(const CLxValue* from)
+    {
+        const Value* v = dynamic_cast<const Value*>(from);
+
+        hitCount         = v->hitCount;
+        missCount        = v->missCount;
+        min              = v->min;
+        max              = v->max;
+        mean             = v->mean;
+        percentileValues = v->percentileValues;
+        histogram        = v->histogram;
+    }
+
+    int Value::compare(const CLxValue* from)
+    {
+        const Value* v = dynamic_cast<const Value*>(from);
+
+        if (hitCount != v->hitCount || missCount != v->missCount || min != v->min || max != v->max || mean != v->mean)
+            return -1;
+        else if (percentileValues != v->percentileValues || histogram != v->histogram)
+            return 1;
+
+        return 0;
+    }
+
+    static CLxMeta_Value<Value> val_meta(servers::stats.c_str());
+    static class CRoot : public CLxMetaRoot
+    {
+        bool pre_init() override
+        {
+            add(&val_meta);
+            return false;
+        }
+    } root_meta;
+}  // namespace statsData
+
 // The more interesting side of things is our item type itself.
 namespace thicknessMeasurer
 {
     // The CLxChannels class defines the channels on our item.
-    // We just have our min and max thicknesses, and our custom
-    // channel type holding the currently too thick/thin polys.
+    // The user sets the min and max thicknesses, whether edits are
+    // recast incrementally, and the rays per poly with their cone angle
+    // and statistic.  The custom channels hold the cached ray hits, the
+    // currently too thick/thin polys, and the mesh summary, whose
+    // histogram gets the given number of buckets.
+    static LXtTextValueHint statisticHints[] = { { static_cast<int>(thicknessCore::Statistic::minimum), "minimum" },
+                                                 { static_cast<int>(thicknessCore::Statistic::mean), "mean" },
+                                                 { static_cast<int>(thicknessCore::Statistic::median), "median" },
+                                                 { -1, NULL } };
+
     class Channels : public CLxChannels
     {
     public:
@@ -130,8 +286,37 @@ namespace thicknessMeasurer
             desc.add(channels::min.c_str(), LXsTYPE_DISTANCE);
             desc.default_val(0.0);
 
+            desc.add(channels::incremental.c_str(), LXsTYPE_BOOLEAN);
+            desc.default_val(1);
+
+            // Rays per poly, a single ray is the classic check straight down the inverted normal.
+            desc.add(channels::samples.c_str(), LXsTYPE_INTEGER);
+            desc.default_val(1);
+            desc.set_min(1);
+            desc.set_max(static_cast<int>(thicknessCore::maxSampleRays));
+
+            desc.add(channels::coneAngle.c_str(), LXsTYPE_ANGLE);
+            desc.default_val(0.2618);  // 15 degrees
+            desc.set_min(0.0);
+            desc.set_max(1.5708);
+
+            desc.add(channels::statistic.c_str(), LXsTYPE_INTEGER);
+            desc.default_val(static_cast<int>(thicknessCore::Statistic::minimum));
+            desc.hint(statisticHints);
+
+            desc.add(channels::hits.c_str(), hitData::val_meta.type_name());
+            desc.set_storage();
+
             desc.add(channels::polylist.c_str(), polyListData::val_meta.type_name());
             desc.set_storage();
+
+            desc.add(channels::buckets.c_str(), LXsTYPE_INTEGER);
+            desc.default_val(32);
+            desc.set_min(1);
+            desc.set_max(1024);
+
+            desc.add(channels::stats.c_str(), statsData::val_meta.type_name());
+            desc.set_storage();
         }
     };
 
@@ -139,6 +324,19 @@ namespace thicknessMeasurer
     // casts it to our established polyListData::value type to read its member data.
     class DotDrawer : public CLxViewItem3D
     {
+        static void drawPoints(CLxUser_StrokeDraw& stroke, thicknessCore::PointBuffer points, const LXtVector color)
+        {
+            if (points.empty())
+                return;
+
+            stroke.BeginPoints(3.0, color, 1.0);
+            const float* x = points.x();
+            const float* y = points.y();
+            const float* z = points.z();
+            for (auto i = 0u; i < points.size(); ++i)
+                stroke.Vertex3(x[i], y[i], z[i], 0);
+        }
+
         void draw(CLxUser_Item& item, CLxUser_ChannelRead& chan, CLxUser_StrokeDraw& stroke, int, const CLxVector&) override
         {
             static const LXtVector red{ 1.0, 0.0, 0.0 };
@@ -148,43 +346,49 @@ namespace thicknessMeasurer
 
             if (chan.Object(item, channels::polylist.c_str(), val))
             {
+                // Holding on to our own copies keeps the buffers alive while we stream
+                // them, without copying any points.
                 auto* pListWrap = polyListData::val_meta.cast(val);
-                if (!pListWrap->overMax.empty())
-                {
-                    stroke.BeginPoints(3.0, red, 1.0);
-                    for (auto& pt : pListWrap->overMax)
-                        stroke.Vertex3(pt[0], pt[1], pt[2], 0);
-                }
-
-                if (!pListWrap->underMin.empty())
-                {
-                    stroke.BeginPoints(3.0, blue, 1.0);
-                    for (auto& pt : pListWrap->underMin)
-                        stroke.Vertex3(pt[0], pt[1], pt[2], 0);
-                }
+                drawPoints(stroke, pListWrap->overMax, red);
+                drawPoints(stroke, pListWrap->underMin, blue);
             }
         }
     };
 
-    // The modifier reads the user's min/max channels, evaluates the linked mesh, and then writes out the
-    // custom channel data for the list of polys which are outside of the min/max range.
-    class Modifier : public CLxEvalModifier
+    // The evaluation is split over two modifiers.  The caster evaluates the linked mesh and
+    // writes the hit distance of every poly.  Its engine lives as long as the modifier, so it
+    // keeps the results of the previous evaluation around for the incremental mode.
+    class Caster : public CLxEvalModifier
     {
         void bind(CLxUser_Item& item, unsigned ident) override;
         bool change_test() override;
         void eval() override;
 
     private:
-        bool m_valid{};
-
-        void writeThicknessValue(const double max, const double min, CLxUser_Mesh& mesh, polyListData::Value* val);
+        // Attribute indices, in the order bind adds the channels.
+        enum ChanIndex : unsigned
+        {
+            hitsIdx,
+            incrementalIdx,
+            samplesIdx,
+            coneAngleIdx,
+            statisticIdx,
+            meshIdx
+        };
+
+        bool                     m_valid{};
+        thicknessCore::Evaluator m_engine;
+
+        void gatherMesh(CLxUser_Mesh& mesh, thicknessCore::MeshInput& input);
     };
 
-    void Modifier::bind(CLxUser_Item& item, unsigned ident)
+    void Caster::bind(CLxUser_Item& item, unsigned ident)
     {
-        mod_add_chan(item, channels::polylist.c_str(), LXfECHAN_WRITE);
-        mod_add_chan(item, channels::max.c_str(), LXfECHAN_READ);
-        mod_add_chan(item, channels::min.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, channels::hits.c_str(), LXfECHAN_WRITE);
+        mod_add_chan(item, channels::incremental.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, channels::samples.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, channels::coneAngle.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, channels::statistic.c_str(), LXfECHAN_READ);
 
         CLxUser_Scene     scene(item);
         CLxUser_ItemGraph itemGraph;
@@ -198,12 +402,12 @@ namespace thicknessMeasurer
         }
     }
 
-    bool Modifier::change_test()
+    bool Caster::change_test()
     {
         return false;
     }
 
-    void Modifier::eval()
+    void Caster::eval()
     {
         if (!m_valid)
             return;
@@ -211,33 +415,67 @@ namespace thicknessMeasurer
         auto* attr = mod_attr();
 
         CLxUser_Value valObj;
-        attr->ObjectRW(0, valObj);
+        attr->ObjectRW(hitsIdx, valObj);
 
         CLxUser_MeshFilter mFilt;
-        attr->ObjectRO(3, mFilt);
+        attr->ObjectRO(meshIdx, mFilt);
 
         if (!mFilt.test() || !valObj.test())
             return;
 
-        auto maxVal = attr->Float(1);
-        auto minVal = attr->Float(2);
+        auto incremental = attr->Int(incrementalIdx) != 0;
+
+        thicknessCore::Sampling sampling;
+        sampling.rays      = static_cast<uint32_t>(std::max(attr->Int(samplesIdx), 1));
+        sampling.coneAngle = static_cast<float>(attr->Float(coneAngleIdx));
+        sampling.statistic = static_cast<thicknessCore::Statistic>(std::min(std::max(attr->Int(statisticIdx), 0), 2));
 
         CLxUser_Mesh mesh;
         mFilt.GetMesh(mesh);
 
-        auto* val = polyListData::val_meta.cast(valObj);
-        if (val && mesh.test())
-            writeThicknessValue(maxVal, minVal, mesh, val);
+        auto* val = hitData::val_meta.cast(valObj);
+        if (!val || !mesh.test())
+            return;
+
+        thicknessCore::MeshInput input;
+        gatherMesh(mesh, input);
+        m_engine.evaluate(std::move(input), sampling, incremental);
+
+        const auto&        rays = m_engine.mesh().rays;
+        std::vector<float> originX(rays.size());
+        std::vector<float> originY(rays.size());
+        std::vector<float> originZ(rays.size());
+        for (auto i = 0u; i < rays.size(); ++i)
+        {
+            originX[i] = rays[i].origin[0];
+            originY[i] = rays[i].origin[1];
+            originZ[i] = rays[i].origin[2];
+        }
+
+        val->origins        = thicknessCore::PointBuffer(std::move(originX), std::move(originY), std::move(originZ));
+        val->distances      = thicknessCore::FloatBuffer(std::vector<float>(m_engine.distances()));
+        val->pointDistances = thicknessCore::FloatBuffer(std::vector<float>(m_engine.pointDistances()));
+        val->summary        = std::make_shared<const thicknessCore::Summary>(m_engine.summary());
     }
 
-    void Modifier::writeThicknessValue(const double max, const double min, CLxUser_Mesh& mesh, polyListData::Value* val)
+    // Reading the mesh has to go through the SDK accessors, so this part stays on one thread.
+    // Everything after it works on the flat copy.
+    void Caster::gatherMesh(CLxUser_Mesh& mesh, thicknessCore::MeshInput& input)
     {
-        val->overMax.clear();
-        val->underMin.clear();
-
         CLxUser_Polygon polys(mesh);
-        const auto      polyCount = mesh.NPolygons();
-        for (auto i = 0; i < polyCount; ++i)
+        CLxUser_Point   points;
+        points.fromMesh(mesh);
+
+        const auto polyCount = static_cast<uint32_t>(mesh.NPolygons());
+        input.polyIds.resize(polyCount);
+        input.rays.resize(polyCount);
+        input.triOffsets.resize(polyCount + 1u);
+        input.tris.reserve(polyCount * 2u);
+        input.pointOffsets.resize(polyCount + 1u);
+        input.points.reserve(polyCount * 4u);
+        input.pointCount = static_cast<uint32_t>(mesh.NPoints());
+
+        for (auto i = 0u; i < polyCount; ++i)
         {
             LXtVector pos;
             LXtVector norm;
@@ -247,17 +485,306 @@ namespace thicknessMeasurer
             polys.Normal(norm);
             LXx_VSCL(norm, -1.0);
 
-            LXtVector hitNorm;
-            double    hitDist;
-            bool      hitValid = polys.IntersectRay(pos, norm, hitNorm, &hitDist) == LXe_TRUE ? true : false;
-            if (!hitValid)
-                continue;
+            input.polyIds[i]      = reinterpret_cast<uintptr_t>(polys.ID());
+            input.triOffsets[i]   = static_cast<uint32_t>(input.tris.size());
+            input.pointOffsets[i] = static_cast<uint32_t>(input.points.size());
+
+            auto& ray = input.rays[i];
+            for (auto a = 0; a < 3; ++a)
+            {
+                ray.origin[a] = static_cast<float>(pos[a]);
+                ray.dir[a]    = static_cast<float>(norm[a]);
+            }
+            ray.ignorePoly = i;
+
+            // Fan triangulate, which is fine for the convex-ish polys we expect on scans.
+            unsigned vertCount{};
+            polys.VertexCount(&vertCount);
+
+            thicknessCore::Triangle tri{};
+            tri.poly = i;
+            for (auto v = 0u; v < vertCount; ++v)
+            {
+                LXtPointID pointId;
+                polys.VertexByIndex(v, &pointId);
+                points.Select(pointId);
+
+                LXtFVector p;
+                points.Pos(p);
+
+                unsigned pointIndex{};
+                points.Index(&pointIndex);
+                input.points.push_back(pointIndex);
+
+                thicknessCore::Vec3 vert{ p[0], p[1], p[2] };
+                if (v == 0u)
+                    tri.v0 = vert;
+                else if (v == 1u)
+                    tri.v2 = vert;
+                else
+                {
+                    tri.v1 = tri.v2;
+                    tri.v2 = vert;
+                    input.tris.push_back(tri);
+                }
+            }
+        }
+        input.triOffsets[polyCount]   = static_cast<uint32_t>(input.tris.size());
+        input.pointOffsets[polyCount] = static_cast<uint32_t>(input.points.size());
+    }
+
+    // The item is also a falloff, so deformers can use the thickness directly.  Each point's
+    // weight comes from its splatted distance: full weight at or under the min, fading out to
+    // nothing at the max, and nothing for points whose polys all missed.
+    class Falloff : public CLxImpl_Falloff
+    {
+    public:
+        thicknessCore::FloatBuffer pointDistances;
+        float                      min{};
+        float                      max{};
+
+        float    fall_WeightF(const LXtFVector position, LXtPointID point, LXtPolygonID polygon) override;
+        LxResult fall_WeightRun(const float** pos, const LXtPointID* points, const LXtPolygonID* polygons, float* weight, unsigned num) override;
+        LxResult fall_SetMesh(ILxUnknownID mesh, LXtMatrix4 xfrm) override;
+
+    private:
+        float weight(float dist) const;
+
+        util::IdTable             m_points;  // Built in fall_SetMesh, only read after that
+        std::mutex                m_lock;    // Only for fall_SetMesh, the lookups never take it
+    };
+
+    float Falloff::weight(float dist) const
+    {
+        if (!(dist < std::numeric_limits<float>::infinity()))
+            return 0.0f;
+        if (dist <= min)
+            return 1.0f;
+        if (dist >= max)
+            return 0.0f;
+        return (max - dist) / (max - min);
+    }
+
+    float Falloff::fall_WeightF(const LXtFVector, LXtPointID point, LXtPolygonID)
+    {
+        // Deformers call this from several threads, so it only reads the table.
+        const auto index = m_points.find(reinterpret_cast<uintptr_t>(point));
+        return index < pointDistances.size() ? weight(pointDistances[index]) : 0.0f;
+    }
+
+    LxResult Falloff::fall_WeightRun(const float**, const LXtPointID* points, const LXtPolygonID*, float* weights, unsigned num)
+    {
+        // The run is resolved to point indices a block at a time on the stack, then the
+        // weights are worked out in one go.  Nothing is locked or allocated.
+        constexpr uint32_t blockSize = 256u;
+
+        uint32_t   indices[blockSize];
+        const auto distCount = pointDistances.size();
+        for (auto first = 0u; first < num; first += blockSize)
+        {
+            const auto count = std::min(num - first, blockSize);
+            m_points.findRun(points + first, count, indices);
+            for (auto i = 0u; i < count; ++i)
+                weights[first + i] = indices[i] < distCount ? weight(pointDistances[indices[i]]) : 0.0f;
+        }
+
+        return LXe_OK;
+    }
+
+    // The mesh being deformed is expected to be the one we measured, or at least to have
+    // the same points.  Points past the end of the measured mesh just get no weight.  The
+    // accessor is only used here, to map every point id to its index once up front.
+    LxResult Falloff::fall_SetMesh(ILxUnknownID meshObj, LXtMatrix4)
+    {
+        std::lock_guard<std::mutex> scopeLock(m_lock);
+        CLxUser_Mesh                mesh(meshObj);
+        if (!mesh.test())
+            return LXe_FAILED;
+
+        CLxUser_Point points;
+        points.fromMesh(mesh);
+
+        const auto             pointCount = static_cast<uint32_t>(mesh.NPoints());
+        std::vector<uintptr_t> ids(pointCount);
+        for (auto i = 0u; i < pointCount; ++i)
+        {
+            points.SelectByIndex(i);
+            ids[i] = reinterpret_cast<uintptr_t>(points.ID());
+        }
+
+        m_points.build(ids);
+        return LXe_OK;
+    }
+
+    // The second modifier reads the hits and the user's min/max channels, and writes out the
+    // custom channel data for the list of polys which are outside of the min/max range,
+    // along with the item's falloff.
+    class Modifier : public CLxEvalModifier
+    {
+        void bind(CLxUser_Item& item, unsigned ident) override;
+        bool change_test() override;
+        void eval() override;
+
+    private:
+        enum ChanIndex : unsigned
+        {
+            polyListIdx,
+            hitsIdx,
+            maxIdx,
+            minIdx,
+            falloffIdx,
+            bucketsIdx,
+            statsIdx
+        };
+
+        void writeThicknessValue(const double max, const double min, const hitData::Value& hits, polyListData::Value* val);
+        void writeFalloff(const double max, const double min, const hitData::Value& hits);
+        void writeStats(uint32_t buckets, const hitData::Value& hits, statsData::Value* val);
+    };
+
+    void Modifier::bind(CLxUser_Item& item, unsigned ident)
+    {
+        mod_add_chan(item, channels::polylist.c_str(), LXfECHAN_WRITE);
+        mod_add_chan(item, channels::hits.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, channels::max.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, channels::min.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, LXsICHAN_FALLOFF_FALLOFF, LXfECHAN_WRITE);
+        mod_add_chan(item, channels::buckets.c_str(), LXfECHAN_READ);
+        mod_add_chan(item, channels::stats.c_str(), LXfECHAN_WRITE);
+    }
+
+    bool Modifier::change_test()
+    {
+        return false;
+    }
+
+    void Modifier::eval()
+    {
+        auto* attr = mod_attr();
+
+        CLxUser_Value valObj;
+        attr->ObjectRW(polyListIdx, valObj);
+
+        CLxUser_Value hitsObj;
+        attr->ObjectRO(hitsIdx, hitsObj);
+
+        if (!valObj.test() || !hitsObj.test())
+            return;
 
-            if (hitDist > max)
-                val->overMax.push_back({ pos[0], pos[1], pos[2] });
-            else if (hitDist < min)
-                val->underMin.push_back({ pos[0], pos[1], pos[2] });
+        auto maxVal = attr->Float(maxIdx);
+        auto minVal = attr->Float(minIdx);
+
+        auto* val  = polyListData::val_meta.cast(valObj);
+        auto* hits = hitData::val_meta.cast(hitsObj);
+        if (val && hits)
+        {
+            writeThicknessValue(maxVal, minVal, *hits, val);
+            writeFalloff(maxVal, minVal, *hits);
         }
+
+        CLxUser_Value statsObj;
+        attr->ObjectRW(statsIdx, statsObj);
+
+        auto* stats = statsObj.test() ? statsData::val_meta.cast(statsObj) : nullptr;
+        if (stats && hits)
+            writeStats(static_cast<uint32_t>(std::max(attr->Int(bucketsIdx), 1)), *hits, stats);
+    }
+
+    // The heavy lifting was done by the caster's reduction, this just reads off the sketch.
+    void Modifier::writeStats(uint32_t buckets, const hitData::Value& hits, statsData::Value* val)
+    {
+        static const thicknessCore::Summary noHits;
+
+        const auto& summary = hits.summary ? *hits.summary : noHits;
+        val->hitCount       = summary.hitCount;
+        val->missCount      = summary.missCount;
+        val->min            = summary.min;
+        val->max            = summary.max;
+        val->mean           = summary.mean;
+        for (auto i = 0u; i < statsData::percentiles.size(); ++i)
+            val->percentileValues[i] = std::min(std::max(summary.sketch.quantile(statsData::percentiles[i]), summary.min), summary.max);
+        val->histogram = thicknessCore::histogram(summary, buckets);
+    }
+
+    // A new falloff object each time, they're cheap since the point distances are shared.
+    void Modifier::writeFalloff(const double max, const double min, const hitData::Value& hits)
+    {
+        CLxUser_ValueReference ref;
+        if (!mod_attr()->ObjectRW(falloffIdx, ref))
+            return;
+
+        static CLxSpawner<Falloff> spawner(servers::falloff.c_str());
+
+        ILxUnknownID obj{};
+        auto*        falloff    = spawner.Alloc(obj);
+        falloff->pointDistances = hits.pointDistances;
+        falloff->min            = static_cast<float>(min);
+        falloff->max            = static_cast<float>(max);
+
+        ref.SetObject(obj);
+        lx::UnkRelease(obj);
+    }
+
+    void Modifier::writeThicknessValue(const double max, const double min, const hitData::Value& hits, polyListData::Value* val)
+    {
+        const auto polyCount = static_cast<uint32_t>(hits.distances.size());
+
+        // This is the only work done while the thresholds change, so it's a flat pass over
+        // the cached distances split into chunks over every core.  Each chunk collects its
+        // own over/under polys and they're gathered in chunk order, so the output never
+        // depends on thread timing and the buffer hashes only change when the result does.
+        static constexpr uint32_t grain = 4096u;
+
+        struct ChunkResult
+        {
+            std::vector<uint32_t> overMax;
+            std::vector<uint32_t> underMin;
+        };
+        std::vector<ChunkResult> results(parallel::chunkCount(polyCount, grain));
+
+        parallel::forChunks(polyCount,
+                            grain,
+                            [&](uint32_t chunk, uint32_t begin, uint32_t end, uint32_t)
+                            {
+                                std::array<uint8_t, grain> classes;
+                                thicknessCore::classify(hits.distances.data() + begin, end - begin, static_cast<float>(min), static_cast<float>(max), classes.data());
+
+                                auto& result = results[chunk];
+                                for (auto i = begin; i < end; ++i)
+                                {
+                                    const auto cls = classes[i - begin];
+                                    if (cls == thicknessCore::overMax)
+                                        result.overMax.push_back(i);
+                                    else if (cls == thicknessCore::underMin)
+                                        result.underMin.push_back(i);
+                                }
+                            });
+
+        // Copies the origins of the flagged polys out one axis at a time.
+        auto gather = [&](std::vector<uint32_t> ChunkResult::*polys)
+        {
+            size_t count = 0u;
+            for (const auto& result : results)
+                count += (result.*polys).size();
+
+            std::vector<float> x;
+            std::vector<float> y;
+            std::vector<float> z;
+            x.reserve(count);
+            y.reserve(count);
+            z.reserve(count);
+            for (const auto& result : results)
+                for (auto poly : result.*polys)
+                {
+                    x.push_back(hits.origins.x()[poly]);
+                    y.push_back(hits.origins.y()[poly]);
+                    z.push_back(hits.origins.z()[poly]);
+                }
+            return thicknessCore::PointBuffer(std::move(x), std::move(y), std::move(z));
+        };
+
+        val->overMax  = gather(&ChunkResult::overMax);
+        val->underMin = gather(&ChunkResult::underMin);
     }
 
     // The metaclass registration is confusing, but allows for a lot less code than the
@@ -271,24 +798,29 @@ namespace thicknessMeasurer
     static CLxMeta_ViewItem3D<DotDrawer> v3d_meta;
 
     static CLxMeta_SchematicConnection<CLxSchematicConnection> schm_meta(servers::graph.c_str());
+    static CLxMeta_EvalModifier<Caster>                        cast_meta(servers::caster.c_str());
     static CLxMeta_EvalModifier<Modifier>                      mod_meta(servers::modifier.c_str());
 
     static class CRoot : public CLxMetaRoot
     {
         bool pre_init() override
         {
-            pkg_meta.set_supertype(LXsITYPE_ITEMMODIFY);
+            pkg_meta.set_supertype(LXsITYPE_FALLOFF);
             pkg_meta.add_tag(LXsPKG_GRAPHS, servers::graph.c_str());
             pkg_meta.add(&v3d_meta);
 
             schm_meta.set_itemtype(servers::package.c_str());
             schm_meta.set_graph(servers::graph.c_str());
 
-            mod_meta.add_dependent_graph(servers::graph.c_str());
+            cast_meta.add_dependent_graph(servers::graph.c_str());
+
+            // The falloff objects are plain com objects rather than meta ones.
+            CLxSpawner_Falloff<Falloff>(servers::falloff.c_str());
 
             add(&chan_meta);
             add(&schm_meta);
             add(&pkg_meta);
+            add(&cast_meta);
             add(&mod_meta);
 
             return false;